@@ -29,6 +29,9 @@
     #endif
 #endif
 #include "RF24Network.h"
+#if defined(ENABLE_REPLAY) && defined(RF24_LINUX)
+    #include "RF24NetworkReplay.h"
+#endif
 #if defined(USE_RF24_LIB_SRC)
     #include <RF24.h>
 #endif
@@ -49,32 +52,370 @@ uint16_t RF24NetworkHeader::next_id = 1;
 #define NETWORK_MULTICAST_ADDRESS_LEVEL_2 010
 #define NETWORK_MULTICAST_ADDRESS_LEVEL_4 01000
 
+#if defined(ENABLE_DEFERRED_TX)
+    #define DEFERRED_TX_NONE 255
+#endif
+
+#if defined(ENABLE_COMPRESSION) && !defined(DISABLE_FRAGMENTATION)
+/******************************************************************/
+/*
+ * LZSS coding of compressed messages. The bit stream (MSB first) is a sequence of tokens:
+ * a 1 bit and 8 bits for a literal byte, or a 0 bit, 8 bits of (offset - 1) and 4 bits of
+ * (length - 3) to repeat 3 to 18 bytes from the last 256 decompressed bytes. The padding
+ * bits of the last byte (zeros) are too short for another token.
+ */
+    #define LZSS_WINDOW     256
+    #define LZSS_MIN_MATCH  3
+    #define LZSS_MAX_MATCH  18
+    #define LZSS_LITERAL    9  // bits per literal token
+    #define LZSS_MATCH_BITS 13 // bits per match token
+
+/* The state of a message being compressed, so it can be produced one fragment at a time */
+struct lzssEncoder
+{
+    const uint8_t* data;
+    uint16_t len;
+    uint16_t pos;   // The next byte of `data` to encode
+    uint32_t bits;  // Encoded bits that weren't output yet
+    uint8_t count;  // The number of bits in `bits`
+    uint16_t bytes; // The number of bytes output so far
+    int16_t slack;  // The most that decompression (in place) gets ahead of the compressed data
+};
+
+static void lzss_begin(lzssEncoder& encoder, const void* data, uint16_t len)
+{
+    encoder.data = (const uint8_t*)data;
+    encoder.len = len;
+    encoder.pos = 0;
+    encoder.count = 0;
+    encoder.bytes = 0;
+    encoder.slack = 0;
+}
+
+/* Output up to `maxlen` compressed bytes to `out` (or only count them if `out` is NULL) */
+static uint16_t lzss_compress(lzssEncoder& encoder, uint8_t* out, uint16_t maxlen)
+{
+    uint16_t n = 0;
+    while (n < maxlen) {
+        if (encoder.count >= 8 || (encoder.pos >= encoder.len && encoder.count)) {
+            uint8_t byte = encoder.count >= 8 ? encoder.bits >> (encoder.count - 8) : encoder.bits << (8 - encoder.count);
+            encoder.count = encoder.count >= 8 ? encoder.count - 8 : 0;
+            if (out) {
+                out[n] = byte;
+            }
+            ++n;
+            ++encoder.bytes;
+            continue;
+        }
+        if (encoder.pos >= encoder.len) {
+            break;
+        }
+
+        // Find the longest match in the window
+        const uint8_t* data = encoder.data + encoder.pos;
+        uint16_t available = rf24_min(encoder.len - encoder.pos, LZSS_MAX_MATCH);
+        uint16_t best = 0, best_offset = 0;
+        for (uint16_t offset = 1; offset <= LZSS_WINDOW && offset <= encoder.pos && best < available; ++offset) {
+            uint16_t length = 0;
+            while (length < available && data[length] == data[(int)length - offset]) {
+                ++length;
+            }
+            if (length > best) {
+                best = length;
+                best_offset = offset;
+            }
+        }
+
+        if (best >= LZSS_MIN_MATCH) {
+            encoder.bits = (encoder.bits << LZSS_MATCH_BITS) | ((uint32_t)(best_offset - 1) << 4) | (best - LZSS_MIN_MATCH);
+            encoder.count += LZSS_MATCH_BITS;
+            encoder.pos += best;
+        }
+        else {
+            encoder.bits = (encoder.bits << LZSS_LITERAL) | 0x100 | *data;
+            encoder.count += LZSS_LITERAL;
+            encoder.pos++;
+        }
+        // The decompressor has loaded all the bytes holding this token when it writes the output
+        int16_t slack = encoder.pos - (encoder.bytes + (encoder.count + 7) / 8);
+        if (slack > encoder.slack) {
+            encoder.slack = slack;
+        }
+    }
+    return n;
+}
+
+/* Read `n` bits from the compressed data, returns false at the end of the data */
+static bool lzss_read(const uint8_t*& in, const uint8_t* end, uint32_t& bits, uint8_t& count, uint8_t n, uint16_t& value)
+{
+    while (count < n) {
+        if (in >= end) {
+            return false;
+        }
+        bits = (bits << 8) | *in++;
+        count += 8;
+    }
+    count -= n;
+    value = (bits >> count) & ((1 << n) - 1);
+    return true;
+}
+
+/*
+ * Decompress the `len` bytes at the start of `buffer` in place. The compressed data is moved to
+ * the end of the buffer first, and the output must not overtake it.
+ * Returns the decompressed size, or 0 if the data is corrupt or doesn't fit in `capacity` bytes.
+ */
+static uint16_t lzss_decompress(uint8_t* buffer, uint16_t len, uint16_t capacity)
+{
+    if (len > capacity) {
+        return 0;
+    }
+    const uint8_t* in = buffer + capacity - len;
+    const uint8_t* end = buffer + capacity;
+    memmove(buffer + capacity - len, buffer, len);
+
+    uint8_t* out = buffer;
+    uint32_t bits = 0;
+    uint8_t count = 0;
+    uint16_t token;
+    while (lzss_read(in, end, bits, count, 1, token)) {
+        if (token) {
+            if (!lzss_read(in, end, bits, count, 8, token)) {
+                break; // Padding
+            }
+            if (out >= in) {
+                return 0;
+            }
+            *out++ = token;
+            continue;
+        }
+        if (!lzss_read(in, end, bits, count, LZSS_MATCH_BITS - 1, token)) {
+            break; // Padding
+        }
+        uint16_t offset = (token >> 4) + 1;
+        uint8_t length = (token & 0x0F) + LZSS_MIN_MATCH;
+        if (offset > out - buffer || out + length > in) {
+            return 0;
+        }
+        while (length--) {
+            *out = *(out - offset);
+            ++out;
+        }
+    }
+    return out - buffer;
+}
+/******************************************************************/
+#endif
+
 #if defined(RF24_LINUX)
 /******************************************************************/
-template<class radio_t>
-ESBNetwork<radio_t>::ESBNetwork(radio_t& _radio) : radio(_radio), frame_size(RF24NETWORK_MAX_FRAME_SIZE)
+template<class radio_t, class config_t>
+ESBNetworkBase<radio_t, config_t>::ESBNetworkBase(radio_t& _radio) : radio(_radio), frame_size(RF24NETWORK_MAX_FRAME_SIZE)
 {
     networkFlags = 0;
     returnSysMsgs = 0;
     multicastRelay = 0;
+    tx_frames = 0;
+    budget_exhausted = false;
+    maxQueuedFrames = NETWORK_QUEUE_FRAMES;
+    maxExternalFrames = NETWORK_EXTERNAL_QUEUE_FRAMES;
+    dropPolicy = NETWORK_DROP_NEWEST;
+    memset(type_drop_policy, 255, sizeof(type_drop_policy));
+    frame_queue_drops = 0;
+    external_queue_drops = 0;
+    #if defined(ENABLE_DEFERRED_TX)
+    memset(deferred, 0, sizeof(deferred));
+    memset(deferred_wheel, DEFERRED_TX_NONE, sizeof(deferred_wheel));
+    deferred_pos = 0;
+    deferred_count = 0;
+    deferred_firing = false;
+    #endif
+    #if defined(RF24NetworkMulticast) && defined(ENABLE_MULTICAST_DEDUP)
+    memset(multicast_dedup, 0xFF, sizeof(multicast_dedup)); // 0xFFFF is never a valid from_node
+    multicast_dedup_next = 0;
+    multicast_duplicates = 0;
+    #endif
+    #if defined(ENABLE_UNICAST_DEDUP)
+    memset(unicast_dedup, 0xFF, sizeof(unicast_dedup));
+    unicast_dedup_next = 0;
+    unicast_duplicates = 0;
+    #endif
+    #if defined(ENABLE_FLOW_CONTROL)
+    memset(flow_paused, 0xFF, sizeof(flow_paused));
+    memset(flow_pausing, 0xFF, sizeof(flow_pausing));
+    #endif
+    #if defined(ENABLE_TYPE_HANDLERS)
+    memset(handlers, 0, sizeof(handlers));
+    #endif
+    #if defined(ENABLE_COMPACT_FRAGMENTS)
+    memset(compact_tx, 0xFF, sizeof(compact_tx));
+    memset(compact_rx, 0xFF, sizeof(compact_rx));
+    compact_tx_next = 0;
+    compact_rx_next = 0;
+    compact_links = 0;
+    #endif
+    #if defined(ENABLE_AGGREGATION)
+    aggregateDelay = 0;
+    aggregate_tx_size = 0;
+    aggregate_rx_size = 0;
+    #endif
+    #if defined(ENABLE_NEIGHBOR_ROUTES)
+    for (uint8_t i = 0; i < NETWORK_NEIGHBORS; ++i) {
+        neighbors[i].node = NETWORK_MULTICAST_ADDRESS;
+    }
+    #endif
+    #if defined(ENABLE_PATH_MTU)
+    for (uint8_t i = 0; i < NETWORK_PATH_MTU_NODES; ++i) {
+        path_mtus[i].node = NETWORK_MULTICAST_ADDRESS;
+    }
+    #endif
+    #if defined(ENABLE_GATHER_WRITES)
+    #endif
+    #if defined(ENABLE_FRAGMENT_STREAMING)
+    fragment_handler = NULL;
+    stream_active = false;
+    #endif
+    #if defined(ENABLE_ACK_PIGGYBACK)
+    for (uint8_t i = 0; i < NETWORK_HELD_ACKS; ++i) {
+        held_acks[i].to_node = NETWORK_MULTICAST_ADDRESS;
+    }
+    piggyback_acks = 0;
+    #endif
+    #if defined(ENABLE_TDMA)
+    tdmaSlotTime = 0;
+    tdmaContentionSlots = 1;
+    tdma_children = 0;
+    tdma_beacon_slots = 0;
+    tdma_slots = 0;
+    #endif
+    #if defined(ENABLE_GATEWAY)
+    memset(gateway_routes, 0, sizeof(gateway_routes));
+    #endif
+    #if defined(ENABLE_CAPTURE)
+    capture_handler = NULL;
+    #endif
+    #if defined(ENABLE_FAIR_QUEUING)
+    maxSourceQueue = NETWORK_QUEUE_FRAMES / 2;
+    memset(fair_deficit, 0, sizeof(fair_deficit));
+    fair_next = 0;
+    fair_fresh = true;
+    #endif
+    #if defined(ENABLE_COALESCING)
+    memset(coalesce_types, 0, sizeof(coalesce_types));
+    #endif
+    #if defined(ENABLE_JUMBO_MESSAGES)
+    maxJumboSize = NETWORK_JUMBO_MAX_SIZE;
+    jumbo_key = 0;
+    #endif
 }
 #else
-template<class radio_t>
-ESBNetwork<radio_t>::ESBNetwork(radio_t& _radio) : radio(_radio), next_frame(frame_queue)
+template<class radio_t, class config_t>
+ESBNetworkBase<radio_t, config_t>::ESBNetworkBase(radio_t& _radio) : radio(_radio), next_frame(frame_queue)
 {
     #if !defined(DISABLE_FRAGMENTATION)
+        #if defined(ENABLE_SHARED_RX_BUFFER)
+    frag_queue.message_buffer = next_frame + 10;
+    frag_queue.header.reserved = 0;
+        #else
     frag_queue.message_buffer = &frag_queue_message_buffer[0];
+        #endif
     frag_ptr = &frag_queue;
+        #if defined(ENABLE_COMPRESSION)
+    frag_compressed = false;
+        #endif
     #endif
     networkFlags = 0;
     returnSysMsgs = 0;
     multicastRelay = 0;
+    tx_frames = 0;
+    budget_exhausted = false;
+    #if defined(ENABLE_DEFERRED_TX)
+    memset(deferred, 0, sizeof(deferred));
+    memset(deferred_wheel, DEFERRED_TX_NONE, sizeof(deferred_wheel));
+    deferred_pos = 0;
+    deferred_count = 0;
+    deferred_firing = false;
+    #endif
+    #if defined(RF24NetworkMulticast) && defined(ENABLE_MULTICAST_DEDUP)
+    memset(multicast_dedup, 0xFF, sizeof(multicast_dedup)); // 0xFFFF is never a valid from_node
+    multicast_dedup_next = 0;
+    multicast_duplicates = 0;
+    #endif
+    #if defined(ENABLE_UNICAST_DEDUP)
+    memset(unicast_dedup, 0xFF, sizeof(unicast_dedup));
+    unicast_dedup_next = 0;
+    unicast_duplicates = 0;
+    #endif
+    #if defined(ENABLE_FLOW_CONTROL)
+    memset(flow_paused, 0xFF, sizeof(flow_paused));
+    memset(flow_pausing, 0xFF, sizeof(flow_pausing));
+    #endif
+    #if defined(ENABLE_TYPE_HANDLERS)
+    memset(handlers, 0, sizeof(handlers));
+    #endif
+    #if defined(ENABLE_COMPACT_FRAGMENTS)
+    memset(compact_tx, 0xFF, sizeof(compact_tx));
+    memset(compact_rx, 0xFF, sizeof(compact_rx));
+    compact_tx_next = 0;
+    compact_rx_next = 0;
+    compact_links = 0;
+    #endif
+    #if defined(ENABLE_AGGREGATION)
+    aggregateDelay = 0;
+    aggregate_tx_size = 0;
+    aggregate_rx_size = 0;
+    #endif
+    #if defined(ENABLE_NEIGHBOR_ROUTES)
+    for (uint8_t i = 0; i < NETWORK_NEIGHBORS; ++i) {
+        neighbors[i].node = NETWORK_MULTICAST_ADDRESS;
+    }
+    #endif
+    #if defined(ENABLE_PATH_MTU)
+    for (uint8_t i = 0; i < NETWORK_PATH_MTU_NODES; ++i) {
+        path_mtus[i].node = NETWORK_MULTICAST_ADDRESS;
+    }
+    #endif
+    #if defined(ENABLE_GATHER_WRITES)
+    #endif
+    #if defined(ENABLE_FRAGMENT_STREAMING)
+    fragment_handler = NULL;
+    stream_active = false;
+    #endif
+    #if defined(ENABLE_ACK_PIGGYBACK)
+    for (uint8_t i = 0; i < NETWORK_HELD_ACKS; ++i) {
+        held_acks[i].to_node = NETWORK_MULTICAST_ADDRESS;
+    }
+    piggyback_acks = 0;
+    #endif
+    #if defined(ENABLE_TDMA)
+    tdmaSlotTime = 0;
+    tdmaContentionSlots = 1;
+    tdma_children = 0;
+    tdma_beacon_slots = 0;
+    tdma_slots = 0;
+    #endif
+    #if defined(ENABLE_GATEWAY)
+    memset(gateway_routes, 0, sizeof(gateway_routes));
+    #endif
+    #if defined(ENABLE_CAPTURE)
+    capture_handler = NULL;
+    #endif
+    #if defined(ENABLE_FAIR_QUEUING)
+    maxSourceQueue = sizeof(frame_queue) / 2;
+    memset(fair_deficit, 0, sizeof(fair_deficit));
+    fair_next = 0;
+    fair_fresh = true;
+    fair_head = NULL;
+    #endif
+    #if defined(ENABLE_COALESCING)
+    memset(coalesce_types, 0, sizeof(coalesce_types));
+    #endif
 }
 #endif
 /******************************************************************/
 
-template<class radio_t>
-void ESBNetwork<radio_t>::begin(uint8_t _channel, uint16_t _node_address)
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::begin(uint8_t _channel, uint16_t _node_address)
 {
     if (!is_valid_address(_node_address))
         return;
@@ -114,13 +455,42 @@ void ESBNetwork<radio_t>::begin(uint8_t _channel, uint16_t _node_address)
     }
 
     radio.startListening();
+
+#if defined(ENABLE_COMPACT_FRAGMENTS)
+    // The neighbors change with the address
+    compact_links = 0;
+    memset(compact_tx, 0xFF, sizeof(compact_tx));
+    if (node_address && node_address != NETWORK_DEFAULT_ADDRESS) {
+        send_compact_hello(parent_node, 1);
+    }
+#endif
+#if defined(ENABLE_AGGREGATION)
+    aggregate_tx_size = 0;
+    aggregate_rx_size = 0;
+#endif
+#if defined(ENABLE_NEIGHBOR_ROUTES)
+    // The routes saved by neighbors depend on the address
+    for (uint8_t i = 0; i < NETWORK_NEIGHBORS; ++i) {
+        neighbors[i].node = NETWORK_MULTICAST_ADDRESS;
+    }
+#endif
+#if defined(ENABLE_ACK_PIGGYBACK)
+    for (uint8_t i = 0; i < NETWORK_HELD_ACKS; ++i) {
+        held_acks[i].to_node = NETWORK_MULTICAST_ADDRESS;
+    }
+#endif
+#if defined(ENABLE_TDMA)
+    // The parent and children change with the address
+    tdma_children = 0;
+    tdma_slots = 0;
+#endif
 }
 
 #if defined ENABLE_NETWORK_STATS
 /******************************************************************/
 
-template<class radio_t>
-void ESBNetwork<radio_t>::failures(uint32_t* _fails, uint32_t* _ok)
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::failures(uint32_t* _fails, uint32_t* _ok)
 {
     *_fails = nFails;
     *_ok = nOK;
@@ -129,36 +499,134 @@ void ESBNetwork<radio_t>::failures(uint32_t* _fails, uint32_t* _ok)
 
 /******************************************************************/
 
-template<class radio_t>
-uint8_t ESBNetwork<radio_t>::update(void)
+template<class radio_t, class config_t>
+uint8_t ESBNetworkBase<radio_t, config_t>::update(void)
+{
+    return update(0, 0);
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+uint8_t ESBNetworkBase<radio_t, config_t>::update(uint8_t maxFrames, uint32_t maxMicros)
 {
 
     uint8_t returnVal = 0;
+    uint32_t start = micros();
+    uint8_t sent = tx_frames;
+    budget_exhausted = false;
+
+#if defined(ENABLE_DEFERRED_TX)
+    write_deferred();
+#endif
+#if defined(ENABLE_FLOW_CONTROL)
+    flow_resume();
+#endif
+#if defined(ENABLE_AGGREGATION)
+    if (aggregate_tx_size && millis() - aggregate_tx_time >= aggregateDelay) {
+        flushAggregate();
+    }
+#endif
+#if defined(ENABLE_ACK_PIGGYBACK)
+    send_held_acks();
+#endif
+#if defined(ENABLE_FRAGMENT_STREAMING)
+    if (stream_active && millis() - stream_time >= FRAGMENT_STREAM_TIMEOUT) {
+        stream_abort();
+    }
+#endif
+#if defined(ENABLE_TDMA)
+    if (tdmaSlotTime && millis() - tdma_beacon_time >= (uint32_t)(tdma_beacon_slots + 1) * tdmaSlotTime) {
+        send_beacon();
+    }
+#endif
 
+    // The frames sent above are charged to the budget, the time is charged through `start`
+    sent = tx_frames - sent;
+    uint8_t frames = (maxFrames && sent > maxFrames) ? maxFrames : sent;
+    uint8_t received = 0;
     uint32_t timeout = millis() + 100;
 
+#if defined(ENABLE_AGGREGATION)
+    // The sub-messages of a received NETWORK_AGGREGATE are handled before the next frame is read
+    while (aggregate_rx_size || radio.available()) {
+#else
     while (radio.available()) {
+#endif
         if (millis() > timeout) {
             return NETWORK_OVERRUN;
         }
+        // The frames left over the budget stay in the RX FIFO for the next call. At least one is received
+        if (received && ((maxFrames && frames >= maxFrames) || (maxMicros && micros() - start >= maxMicros))) {
+            budget_exhausted = true;
+            return returnVal;
+        }
+        ++received;
+        ++frames;
+#if defined(ENABLE_AGGREGATION)
+        if (aggregate_rx_size) {
+            unpack_aggregate();
+        }
+        else
+#endif
+        {
 #if defined(ENABLE_DYNAMIC_PAYLOADS) && !defined(XMEGA_D3)
-        frame_size = radio.getDynamicPayloadSize();
+            frame_size = radio.getDynamicPayloadSize();
 #else
-        frame_size = RF24NETWORK_MAX_FRAME_SIZE;
+            frame_size = RF24NETWORK_MAX_FRAME_SIZE;
+#endif
+            if (!frame_size) {
+                return NETWORK_CORRUPTION;
+            }
+#if defined(ENABLE_CAPTURE)
+            uint8_t pipe = 0;
+            radio.available(&pipe);
+#endif
+            // Fetch the payload, and see if this was the last one.
+            radio.read(frame_buffer, frame_size);
+#if defined(ENABLE_CAPTURE)
+            capture(frame_buffer, frame_size, node_address, pipe, RF24NETWORK_CAPTURE_OK | (pipe ? 0 : RF24NETWORK_CAPTURE_MULTICAST), micros());
 #endif
-        if (!frame_size) {
-            return NETWORK_CORRUPTION;
         }
-        // Fetch the payload, and see if this was the last one.
-        radio.read(frame_buffer, frame_size);
 
         // Read the beginning of the frame as the header
         RF24NetworkHeader* header = (RF24NetworkHeader*)(&frame_buffer);
 
+#if defined(ENABLE_COMPACT_FRAGMENTS)
+        // The high byte of a valid from_node address is never 0xF0 or more
+        if (frame_size >= NETWORK_COMPACT_HEADER_SIZE && (frame_buffer[1] & 0xF0) == 0xF0 && !expand_frame()) {
+            IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("FRG Drop compact fragment of unknown or ambiguous message %u\n"), frame_buffer[0]););
+            continue;
+        }
+#endif
+
         // Throw it away if it's not a valid address or too small
         if (frame_size < sizeof(RF24NetworkHeader) || !is_valid_address(header->to_node) || !is_valid_address(header->from_node)) {
             continue;
         }
+#if defined(ENABLE_COMPACT_FRAGMENTS)
+        if (header->type == NETWORK_FIRST_FRAGMENT && header->to_node != NETWORK_MULTICAST_ADDRESS) {
+            // The continuation fragments may follow with a compact header, from the neighbor on the route from the sender
+            compactContext context = {header->from_node, header->to_node, header->id, (uint8_t)0};
+            if (header->from_node != node_address && is_descendant(header->from_node)) {
+                context.link = link_index(direct_child_route_to(header->from_node));
+            }
+            compact_store(compact_rx, compact_rx_next, context);
+        }
+        else if (header->type == NETWORK_LAST_FRAGMENT) {
+            // The neighbor forgets a message once its last fragment is sent, with a full header or not
+            for (uint8_t i = 0; i < NETWORK_COMPACT_CONTEXTS; ++i) {
+                if (compact_rx[i].from_node == header->from_node && compact_rx[i].id == header->id) {
+                    compact_rx[i].link = 0xFF;
+                }
+            }
+        }
+#endif
+#if defined(ENABLE_TDMA)
+        if (tdmaSlotTime) {
+            tdma_heard_from(header->from_node);
+        }
+#endif
         //IF_RF24NETWORK_DEBUG(printf_P(PSTR("MAC Received " PRIPSTR
         //                              "\n\r"),
         //                         header->toString()));
@@ -171,12 +639,76 @@ uint8_t ESBNetwork<radio_t>::update(void)
         IF_RF24NETWORK_DEBUG(const uint16_t* i = reinterpret_cast<const uint16_t*>(frame_buffer + sizeof(RF24NetworkHeader)); printf_P(PSTR("NET message %04x\n\r"), *i));
 #endif
 
+#if defined(ENABLE_PATH_MTU)
+        if (header->type == NETWORK_MTU_PROBE && frame_size > sizeof(RF24NetworkHeader)) {
+            // Every node that routes or receives the probe lowers its payload size to its own radio's
+            frame_buffer[sizeof(RF24NetworkHeader)] = rf24_min(frame_buffer[sizeof(RF24NetworkHeader)], link_payload_size());
+        }
+#endif
+
         returnVal = header->type;
         // Is this for us?
         if (header->to_node == node_address) {
+#if defined(ENABLE_ACK_PIGGYBACK)
+            bool ackReceived = false;
+            if (header->type <= MAX_USER_DEFINED_HEADER_TYPE && (header->reserved & NETWORK_PIGGYBACK_ACK)) {
+                header->reserved &= ~NETWORK_PIGGYBACK_ACK;
+                ackReceived = true;
+            }
+#endif
             if (header->type == NETWORK_PING) {
                 continue;
             }
+#if defined(ENABLE_FLOW_CONTROL)
+            if (header->type == NETWORK_FLOW_CONTROL) {
+                flow_received(header);
+                continue;
+            }
+#endif
+#if defined(ENABLE_COMPACT_FRAGMENTS)
+            if (header->type == NETWORK_COMPACT_HELLO) {
+                uint8_t link = link_index(header->from_node);
+                if (link != 0xFF) {
+                    compact_links |= 1 << link;
+                    if (frame_size > sizeof(RF24NetworkHeader) && frame_buffer[sizeof(RF24NetworkHeader)]) {
+                        send_compact_hello(header->from_node, 0);
+                    }
+                }
+                continue;
+            }
+#endif
+#if defined(ENABLE_AGGREGATION)
+            if (header->type == NETWORK_AGGREGATE) {
+                memcpy(aggregate_rx, frame_buffer, frame_size);
+                aggregate_rx_size = frame_size;
+                aggregate_rx_pos = sizeof(RF24NetworkHeader);
+                continue;
+            }
+#endif
+#if defined(ENABLE_NEIGHBOR_ROUTES)
+            if (header->type == NETWORK_NEIGHBOR_PROBE) {
+                if (header->from_node != parent_node && !(is_descendant(header->from_node) && is_direct_child(header->from_node))) {
+                    neighbor_store(header->from_node, true);
+                }
+                continue;
+            }
+#endif
+#if defined(ENABLE_PATH_MTU)
+            if (header->type == NETWORK_MTU_PROBE || header->type == NETWORK_MTU_REPLY) {
+                if (frame_size > sizeof(RF24NetworkHeader)) {
+                    uint8_t size = frame_buffer[sizeof(RF24NetworkHeader)];
+                    if (header->type == NETWORK_MTU_PROBE) {
+                        RF24NetworkHeader reply(header->from_node, NETWORK_MTU_REPLY);
+                        write(reply, &size, sizeof(size));
+                    }
+                    else {
+                        IF_RF24NETWORK_DEBUG_ROUTING(printf_P(PSTR("MAC Path MTU of 0%o is %d\n\r"), header->from_node, size););
+                        path_mtu_store(header->from_node, size);
+                    }
+                }
+                continue;
+            }
+#endif
             if (header->type == NETWORK_ADDR_RESPONSE) {
                 uint16_t requester = NETWORK_DEFAULT_ADDRESS;
                 if (requester != node_address) {
@@ -191,47 +723,104 @@ uint8_t ESBNetwork<radio_t>::update(void)
                 write(header->to_node, TX_NORMAL);
                 continue;
             }
+#if defined(ENABLE_TYPE_HANDLERS)
+            // System types with a handler are dispatched instead of being returned
+            if (header->type > MAX_USER_DEFINED_HEADER_TYPE && has_handler(header->type)) {
+                enqueue(header);
+                returnVal = 0;
+                continue;
+            }
+#endif
             if ((returnSysMsgs && header->type > MAX_USER_DEFINED_HEADER_TYPE) || header->type == NETWORK_ACK) {
                 IF_RF24NETWORK_DEBUG_ROUTING(printf_P(PSTR("MAC System payload rcvd %d\n"), returnVal););
-                if (header->type != NETWORK_FIRST_FRAGMENT && header->type != NETWORK_MORE_FRAGMENTS && header->type != EXTERNAL_DATA_TYPE && header->type != NETWORK_LAST_FRAGMENT) {
+                // Stream messages are queued for ESBNetworkStream, which only reads them from the queue
+                if (header->type != NETWORK_FIRST_FRAGMENT && header->type != NETWORK_MORE_FRAGMENTS && header->type != EXTERNAL_DATA_TYPE && header->type != NETWORK_LAST_FRAGMENT && !is_jumbo_fragment(header->type)
+                    && header->type != NETWORK_STREAM_DATA && header->type != NETWORK_STREAM_ACK) {
                     return returnVal;
                 }
             }
 
+#if defined(ENABLE_FLOW_CONTROL) || defined(ENABLE_NEIGHBOR_ROUTES)
+            // The header is in the frame_buffer, which any write() from here on overwrites
+            uint16_t from_node = header->from_node;
+#endif
             if (enqueue(header) == 2) { //External data received
                 IF_RF24NETWORK_DEBUG_MINIMAL(printf_P(PSTR("ret ext\n")););
                 return EXTERNAL_DATA_TYPE;
             }
+#if defined(ENABLE_FLOW_CONTROL)
+            flow_control(from_node);
+#endif
+#if defined(ENABLE_NEIGHBOR_ROUTES)
+            neighbor_learn(from_node);
+#endif
+#if defined(ENABLE_ACK_PIGGYBACK)
+            if (ackReceived) {
+                // Lets the write() waiting for the ACK complete
+                ++piggyback_acks;
+                return returnVal;
+            }
+#endif
         }
         else {
 #if defined(RF24NetworkMulticast)
 
             if (header->to_node == NETWORK_MULTICAST_ADDRESS) {
+    #if defined(ENABLE_TDMA)
+                if (header->type == NETWORK_TDMA_BEACON) {
+                    // Beacons of other parents at the same level are ignored
+                    if (header->from_node == parent_node) {
+                        tdma_sync();
+                    }
+                    returnVal = 0;
+                    continue;
+                }
+    #endif
                 if (header->type == NETWORK_POLL) {
                     returnVal = 0;
                     if (!(networkFlags & FLAG_NO_POLL) && node_address != NETWORK_DEFAULT_ADDRESS) {
                         header->to_node = header->from_node;
                         header->from_node = node_address;
     #ifdef SLOW_ADDR_POLL_RESPONSE
-                        delay(parent_pipe + SLOW_ADDR_POLL_RESPONSE);
+                        uint16_t pollDelay = parent_pipe + SLOW_ADDR_POLL_RESPONSE;
     #else
-                        delay(parent_pipe);
+                        uint16_t pollDelay = parent_pipe;
     #endif
-                        write(header->to_node, USER_TX_TO_PHYSICAL_ADDRESS);
+    #if defined(ENABLE_DEFERRED_TX)
+                        if (!schedule_write(header->to_node, USER_TX_TO_PHYSICAL_ADDRESS, pollDelay))
+    #endif
+                        {
+                            delay(pollDelay);
+                            write(header->to_node, USER_TX_TO_PHYSICAL_ADDRESS);
+                        }
                     }
                     continue;
                 }
 
+    #if defined(ENABLE_MULTICAST_DEDUP)
+                if (is_multicast_duplicate(header)) {
+                    IF_RF24NETWORK_DEBUG_ROUTING(printf_P(PSTR("MAC Drop duplicate multicast frame from 0%o id %u\n"), header->from_node, header->id););
+                    returnVal = 0;
+                    continue;
+                }
+    #endif
+
                 uint8_t val = enqueue(header);
 
                 if (multicastRelay) {
                     IF_RF24NETWORK_DEBUG_ROUTING(printf_P(PSTR("MAC FWD multicast frame from 0%o to level %u\n"), header->from_node, _multicast_level + 1););
-                    if ((node_address >> 3) != 0) {
-                        // for all but the first level of nodes, those not directly connected to the master, we add the total delay per level
-                        delayMicroseconds(600 * 4);
+    #if defined(ENABLE_DEFERRED_TX)
+                    // The wheel ticks in milliseconds, so relays are staggered in 1ms steps instead of 600us
+                    if (!schedule_write(levelToAddress(_multicast_level) << 3, USER_TX_MULTICAST, (node_address % 4) + ((node_address >> 3) != 0 ? 4 : 0)))
+    #endif
+                    {
+                        if ((node_address >> 3) != 0) {
+                            // for all but the first level of nodes, those not directly connected to the master, we add the total delay per level
+                            delayMicroseconds(600 * 4);
+                        }
+                        delayMicroseconds((node_address % 4) * 600);
+                        write(levelToAddress(_multicast_level) << 3, USER_TX_MULTICAST);
                     }
-                    delayMicroseconds((node_address % 4) * 600);
-                    write(levelToAddress(_multicast_level) << 3, USER_TX_MULTICAST);
                 }
                 if (val == 2) { //External data received
                     return EXTERNAL_DATA_TYPE;
@@ -239,13 +828,23 @@ uint8_t ESBNetwork<radio_t>::update(void)
             }
             else {
                 if (node_address != NETWORK_DEFAULT_ADDRESS) {
-                    write(header->to_node, TX_ROUTED); //Send it on, indicate it is a routed payload
+    #if defined(ENABLE_DEFERRED_TX)
+                    if (!defer_routed(header->to_node))
+    #endif
+                    {
+                        write(header->to_node, TX_ROUTED); //Send it on, indicate it is a routed payload
+                    }
                     returnVal = 0;
                 }
             }
 #else  // not defined(RF24NetworkMulticast)
             if (node_address != NETWORK_DEFAULT_ADDRESS) {
-                write(header->to_node, TX_ROUTED); //Send it on, indicate it is a routed payload
+    #if defined(ENABLE_DEFERRED_TX)
+                if (!defer_routed(header->to_node))
+    #endif
+                {
+                    write(header->to_node, TX_ROUTED); //Send it on, indicate it is a routed payload
+                }
                 returnVal = 0;
             }
 #endif // defined(RF24NetworkMulticast)
@@ -258,35 +857,59 @@ uint8_t ESBNetwork<radio_t>::update(void)
 #if defined(RF24_LINUX)
 /******************************************************************/
 
-template<class radio_t>
-uint8_t ESBNetwork<radio_t>::enqueue(RF24NetworkHeader* header)
+template<class radio_t, class config_t>
+uint8_t ESBNetworkBase<radio_t, config_t>::enqueue(RF24NetworkHeader* header)
 {
     uint8_t result = false;
 
-    RF24NetworkFrame frame = RF24NetworkFrame(*header, frame_buffer + sizeof(RF24NetworkHeader), frame_size - sizeof(RF24NetworkHeader));
+    // A frame (and its copy of the payload) is only built for messages that are cached or re-assembled
+    uint8_t* payload = frame_buffer + sizeof(RF24NetworkHeader);
+    uint16_t payload_size = frame_size - sizeof(RF24NetworkHeader);
 
-    bool isFragment = (frame.header.type == NETWORK_FIRST_FRAGMENT || frame.header.type == NETWORK_MORE_FRAGMENTS || frame.header.type == NETWORK_LAST_FRAGMENT);
+    bool isFragment = (header->type == NETWORK_FIRST_FRAGMENT || header->type == NETWORK_MORE_FRAGMENTS || header->type == NETWORK_LAST_FRAGMENT);
+    #if defined(ENABLE_JUMBO_MESSAGES)
+    isFragment |= is_jumbo_fragment(header->type);
+    #endif
 
     // This is sent to itself
-    if (frame.header.from_node == node_address) {
+    if (header->from_node == node_address) {
         if (isFragment) {
             printf_P(PSTR("Cannot enqueue multi-payload frames to self\n"));
             result = false;
         }
-        else if (frame.header.id > 0) {
-            frame_queue.push(frame);
+        else if (header->id > 0) {
+    #if defined(ENABLE_TYPE_HANDLERS)
+            if (!dispatch(*header, payload, payload_size))
+    #endif
+            {
+                push_frame(frame_queue, RF24NetworkFrame(*header, payload, payload_size), maxQueuedFrames, frame_queue_drops);
+            }
             result = true;
         }
     }
+    #if defined(ENABLE_FRAGMENT_STREAMING)
+    else if (isFragment && stream_fragment(*header, payload, payload_size)) {
+        // Handed to the fragment handler instead of being re-assembled
+        result = true;
+    }
+    #endif
     else if (isFragment) {
+        RF24NetworkFrame frame = RF24NetworkFrame(*header, payload, payload_size);
+
         //The received frame contains the a fragmented payload
         //Set the more fragments flag to indicate a fragmented frame
         IF_RF24NETWORK_DEBUG_FRAGMENTATION_L2(printf_P(PSTR("%u: FRG Payload type %d of size %i Bytes with fragmentID '%i' received.\n\r"), millis(), frame.header.type, frame.message_size, frame.header.reserved););
         //Append payload
-        result = appendFragmentToFrame(frame);
+    #if defined(ENABLE_JUMBO_MESSAGES)
+        if (is_jumbo_fragment(frame.header.type)) {
+            result = appendJumboFragment(frame);
+        }
+        else
+    #endif
+            result = appendFragmentToFrame(frame);
 
         //The header.reserved contains the actual header.type on the last fragment
-        if (result && frame.header.type == NETWORK_LAST_FRAGMENT) {
+        if (result && is_last_fragment(frame.header.type)) {
             IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("%u: FRG Last fragment received\n"), millis()));
             IF_RF24NETWORK_DEBUG(printf_P(PSTR("%u: NET Enqueue assembled frame @ %u\n"), millis(), frame_queue.size()));
 
@@ -294,15 +917,46 @@ uint8_t ESBNetwork<radio_t>::enqueue(RF24NetworkHeader* header)
 
             result = f->header.type == EXTERNAL_DATA_TYPE ? 2 : 1;
 
-            if (f->header.id > 0 && f->message_size > 0 && f->message_size <= MAX_PAYLOAD_SIZE) {
+    #if defined(ENABLE_COMPRESSION)
+            if (f->header.reserved & NETWORK_COMPRESSED_FRAGMENTS) {
+                f->header.reserved = 1;
+                f->message_size = lzss_decompress(f->message_buffer, f->message_size, sizeof(f->message_buffer));
+                IF_RF24NETWORK_DEBUG_FRAGMENTATION(if (!f->message_size) { printf_P(PSTR("%u: FRG Dropping frame, decompression failed\n"), millis()); });
+            }
+    #endif
+
+            bool fits = f->message_size <= config_t::maxPayloadSize;
+    #if defined(ENABLE_JUMBO_MESSAGES)
+            fits |= frame.header.type == NETWORK_JUMBO_LAST_FRAGMENT; // Bound by maxJumboSize instead
+    #endif
+            bool queued = false;
+            if (f->header.id > 0 && f->message_size > 0 && fits) {
                 //Load external payloads into a separate queue on linux
                 if (result == 2) {
-                    external_queue.push(frameFragmentsCache[frame.header.from_node]);
+                    // Frames of the external_queue can only hold a message_buffer
+                    if (f->message_size <= sizeof(f->message_buffer)) {
+                        push_frame(external_queue, *f, maxExternalFrames, external_queue_drops);
+                    }
+                    IF_RF24NETWORK_DEBUG_FRAGMENTATION(else { printf_P(PSTR("%u: FRG Dropping jumbo message for the external queue, it exceeds %u bytes\n"), millis(), MAX_PAYLOAD_SIZE); });
                 }
+    #if defined(ENABLE_UNICAST_DEDUP)
+                else if (is_unicast_duplicate(&f->header)) {
+                    IF_RF24NETWORK_DEBUG(printf_P(PSTR("%u: NET Drop duplicate message from 0%o id %u\n"), millis(), f->header.from_node, f->header.id););
+                }
+    #endif
+    #if defined(ENABLE_TYPE_HANDLERS)
+                else if (dispatch(f->header, frame_payload(*f), f->message_size)) {
+                    // Delivered to its handler instead of the queue
+                }
+    #endif
                 else {
-                    frame_queue.push(frameFragmentsCache[frame.header.from_node]);
+                    push_frame(frame_queue, *f, maxQueuedFrames, frame_queue_drops);
+                    queued = true;
                 }
             }
+            if (!queued) {
+                frame_release(*f);
+            }
             frameFragmentsCache.erase(frame.header.from_node);
         }
     }
@@ -312,13 +966,23 @@ uint8_t ESBNetwork<radio_t>::enqueue(RF24NetworkHeader* header)
 
         IF_RF24NETWORK_DEBUG(printf_P(PSTR("%u: NET Enqueue @ %u\n"), millis(), frame_queue.size()));
         // Copy the current frame into the frame queue
-        result = frame.header.type == EXTERNAL_DATA_TYPE ? 2 : 1;
+        result = header->type == EXTERNAL_DATA_TYPE ? 2 : 1;
         //Load external payloads into a separate queue on linux
         if (result == 2) {
-            external_queue.push(frame);
+            push_frame(external_queue, RF24NetworkFrame(*header, payload, payload_size), maxExternalFrames, external_queue_drops);
+        }
+    #if defined(ENABLE_UNICAST_DEDUP)
+        else if (is_unicast_duplicate(header)) {
+            IF_RF24NETWORK_DEBUG(printf_P(PSTR("%u: NET Drop duplicate message from 0%o id %u\n"), millis(), header->from_node, header->id););
+        }
+    #endif
+    #if defined(ENABLE_TYPE_HANDLERS)
+        else if (dispatch(*header, payload, payload_size)) {
+            // Delivered to its handler instead of the queue
         }
+    #endif
         else {
-            frame_queue.push(frame);
+            push_frame(frame_queue, RF24NetworkFrame(*header, payload, payload_size), maxQueuedFrames, frame_queue_drops);
         }
 
     } /* else {
@@ -340,40 +1004,208 @@ uint8_t ESBNetwork<radio_t>::enqueue(RF24NetworkHeader* header)
 
 /******************************************************************/
 
-template<class radio_t>
-bool ESBNetwork<radio_t>::appendFragmentToFrame(RF24NetworkFrame frame)
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::push_frame(std::queue<RF24NetworkFrame>& queue, const RF24NetworkFrame& frame, uint32_t limit, uint32_t& drops)
 {
-
-    // This is the first of 2 or more fragments.
-    if (frame.header.type == NETWORK_FIRST_FRAGMENT) {
-        if (frameFragmentsCache.count(frame.header.from_node) != 0) {
-            RF24NetworkFrame* f = &(frameFragmentsCache[frame.header.from_node]);
-            //Already rcvd first frag
-            if (f->header.id == frame.header.id) {
-                return false;
-            }
-        }
-
-        frameFragmentsCache[frame.header.from_node] = frame;
-        return true;
+    #if defined(ENABLE_COALESCING)
+    if (&queue == &frame_queue && coalesce(frame)) {
+        return;
     }
-    else if (frame.header.type == NETWORK_MORE_FRAGMENTS) {
-
-        if (frameFragmentsCache.count(frame.header.from_node) < 1) {
-            return false;
+    #endif
+    #if defined(ENABLE_FAIR_QUEUING)
+    if (&queue == &frame_queue) {
+        fair_push(frame, limit, drops);
+        return;
+    }
+    #endif
+    if (limit && queue.size() >= limit) {
+        if (drop_policy(frame.header.type) != NETWORK_DROP_OLDEST) {
+            IF_RF24NETWORK_DEBUG(printf_P(PSTR("%u: NET **Drop Payload** Queue full (%u frames)\n"), millis(), (unsigned int)queue.size()););
+            frame_release(frame);
+            drops++;
+            return;
         }
-        RF24NetworkFrame* f = &(frameFragmentsCache[frame.header.from_node]);
-
-        if (f->message_size + frame.message_size > MAX_PAYLOAD_SIZE) {
-            IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("%u: FRG Frame of size %d plus enqueued frame of size %d exceeds max payload size \n"), millis(), frame.message_size, f->message_size););
-            return false;
+        while (queue.size() >= limit) {
+            IF_RF24NETWORK_DEBUG(printf_P(PSTR("%u: NET Queue full, dropped oldest frame from 0%o\n"), millis(), queue.front().header.from_node););
+            frame_release(queue.front());
+            queue.pop();
+            drops++;
         }
+    }
+    queue.push(frame);
+}
 
-        if (f->header.reserved - 1 == frame.header.reserved && f->header.id == frame.header.id) {
-            // Cache the fragment
-            memcpy(f->message_buffer + f->message_size, frame.message_buffer, frame.message_size);
+/******************************************************************/
+
+template<class radio_t, class config_t>
+uint32_t ESBNetworkBase<radio_t, config_t>::queued_frames(void)
+{
+    uint32_t frames = frame_queue.size();
+    #if defined(ENABLE_FAIR_QUEUING)
+    for (uint8_t source = 0; source < NUM_PIPES; ++source) {
+        frames += fair_queues[source].size();
+    }
+    #endif
+    return frames;
+}
+
+    #if defined(ENABLE_COALESCING)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::coalesce(const RF24NetworkFrame& frame)
+{
+    uint16_t from_node = frame.header.from_node;
+    uint8_t type = frame.header.type;
+    if (!isCoalesced(type)) {
+        return false;
+    }
+        #if defined(ENABLE_FAIR_QUEUING)
+    frameQueue* queues[] = {&frame_queue, &fair_queues[fair_source(from_node)]};
+        #else
+    frameQueue* queues[] = {&frame_queue};
+        #endif
+    for (uint8_t i = 0; i < sizeof(queues) / sizeof(queues[0]); ++i) {
+        for (std::deque<RF24NetworkFrame>::iterator it = queues[i]->c.begin(); it != queues[i]->c.end(); ++it) {
+            if (it->header.from_node == from_node && it->header.type == type) {
+                // The message takes the older one's place in the limits, so it is always admitted
+                IF_RF24NETWORK_DEBUG(printf_P(PSTR("%u: NET Replacing unread message from 0%o type %d\n"), millis(), from_node, type););
+                frame_release(*it);
+                queues[i]->c.erase(it);
+                queues[sizeof(queues) / sizeof(queues[0]) - 1]->push(frame);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+    #endif // defined(ENABLE_COALESCING)
+
+    #if defined(ENABLE_FAIR_QUEUING)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::fair_push(const RF24NetworkFrame& frame, uint32_t limit, uint32_t& drops)
+{
+    uint8_t source = fair_source(frame.header.from_node);
+
+    // A source over its share loses its own frames, instead of the other sources' frames
+    frameQueue* victim = NULL;
+    if (maxSourceQueue && fair_queues[source].size() >= maxSourceQueue) {
+        victim = &fair_queues[source];
+    }
+    else if (limit && queued_frames() >= limit) {
+        victim = &fair_queues[source];
+        for (uint8_t i = 0; i < NUM_PIPES; ++i) {
+            if (fair_queues[i].size() > victim->size()) {
+                victim = &fair_queues[i];
+            }
+        }
+    }
+    if (victim) {
+        drops++;
+        if (victim == &fair_queues[source] || victim->empty()) {
+            // The source's own frames: the policy of the received frame's type decides which is dropped
+            if (drop_policy(frame.header.type) != NETWORK_DROP_OLDEST || victim->empty()) {
+                IF_RF24NETWORK_DEBUG(printf_P(PSTR("%u: NET **Drop Payload** Queue of source %d full\n"), millis(), source););
+                frame_release(frame);
+                return;
+            }
+            IF_RF24NETWORK_DEBUG(printf_P(PSTR("%u: NET Queue full, dropped oldest frame from 0%o\n"), millis(), victim->front().header.from_node););
+            frame_release(victim->front());
+            victim->pop();
+        }
+        else if (drop_policy(victim->back().header.type) != NETWORK_DROP_OLDEST) {
+            // Another source's frames: the policy of its newest frame's type decides, as if that frame arrived now
+            IF_RF24NETWORK_DEBUG(printf_P(PSTR("%u: NET Queue full, dropped newest frame from 0%o\n"), millis(), victim->back().header.from_node););
+            frame_release(victim->back());
+            victim->c.pop_back();
+        }
+        else {
+            IF_RF24NETWORK_DEBUG(printf_P(PSTR("%u: NET Queue full, dropped oldest frame from 0%o\n"), millis(), victim->front().header.from_node););
+            frame_release(victim->front());
+            victim->pop();
+        }
+    }
+    fair_queues[source].push(frame);
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+uint32_t ESBNetworkBase<radio_t, config_t>::fair_head_size(uint8_t source)
+{
+    return fair_queues[source].empty() ? 0 : (uint32_t)fair_queues[source].front().message_size + FRAME_HEADER_SIZE;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::fair_stage(void)
+{
+    if (frame_queue.empty()) {
+        uint8_t source = fair_select();
+        if (source < NUM_PIPES) {
+            frame_queue.push(fair_queues[source].front());
+            fair_queues[source].pop();
+        }
+    }
+}
+    #endif // defined(ENABLE_FAIR_QUEUING)
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::setDropPolicy(uint8_t type, uint8_t policy)
+{
+    type_drop_policy[type] = policy == NETWORK_DROP_NEWEST || policy == NETWORK_DROP_OLDEST ? policy : 255;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::appendFragmentToFrame(RF24NetworkFrame frame)
+{
+
+    // This is the first of 2 or more fragments.
+    if (frame.header.type == NETWORK_FIRST_FRAGMENT) {
+        if (frameFragmentsCache.count(frame.header.from_node) != 0) {
+            RF24NetworkFrame* f = &(frameFragmentsCache[frame.header.from_node]);
+            //Already rcvd first frag
+            if (f->header.id == frame.header.id) {
+                return false;
+            }
+        }
+
+        frameFragmentsCache[frame.header.from_node] = frame;
+        return true;
+    }
+    else if (frame.header.type == NETWORK_MORE_FRAGMENTS) {
+
+        if (frameFragmentsCache.count(frame.header.from_node) < 1) {
+            return false;
+        }
+        RF24NetworkFrame* f = &(frameFragmentsCache[frame.header.from_node]);
+
+        if (f->message_size + frame.message_size > config_t::maxPayloadSize) {
+            IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("%u: FRG Frame of size %d plus enqueued frame of size %d exceeds max payload size \n"), millis(), frame.message_size, f->message_size););
+            return false;
+        }
+
+        uint8_t fragments = f->header.reserved;
+    #if defined(ENABLE_COMPRESSION)
+        uint8_t compressed = fragments & NETWORK_COMPRESSED_FRAGMENTS;
+        fragments &= ~NETWORK_COMPRESSED_FRAGMENTS;
+    #endif
+
+        if (fragments - 1 == frame.header.reserved && f->header.id == frame.header.id) {
+            // Cache the fragment
+            memcpy(f->message_buffer + f->message_size, frame.message_buffer, frame.message_size);
             f->message_size += frame.message_size; //Increment message size
             f->header = frame.header;              //Update header
+    #if defined(ENABLE_COMPRESSION)
+            f->header.reserved |= compressed;
+    #endif
             return true;
         }
         else {
@@ -390,12 +1222,17 @@ bool ESBNetwork<radio_t>::appendFragmentToFrame(RF24NetworkFrame frame)
         //Create pointer to the cached frame
         RF24NetworkFrame* f = &(frameFragmentsCache[frame.header.from_node]);
 
-        if (f->message_size + frame.message_size > MAX_PAYLOAD_SIZE) {
+        if (f->message_size + frame.message_size > config_t::maxPayloadSize) {
             IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("%u: FRG Frame of size %d plus enqueued frame of size %d exceeds max payload size \n"), millis(), frame.message_size, f->message_size););
             return false;
         }
+        uint8_t fragments = f->header.reserved;
+    #if defined(ENABLE_COMPRESSION)
+        uint8_t compressed = fragments & NETWORK_COMPRESSED_FRAGMENTS;
+        fragments &= ~NETWORK_COMPRESSED_FRAGMENTS;
+    #endif
         //Error checking for missed fragments and payload size
-        if (f->header.reserved - 1 != 1 || f->header.id != frame.header.id) {
+        if (fragments - 1 != 1 || f->header.id != frame.header.id) {
             IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("%u: FRG Duplicate or out of sequence frame %d, expected %d. Cleared.\n\r"), millis(), frame.header.reserved, f->header.reserved););
             //frameFragmentsCache.erase( std::make_pair(frame.header.id,frame.header.from_node) );
             return false;
@@ -403,6 +1240,9 @@ bool ESBNetwork<radio_t>::appendFragmentToFrame(RF24NetworkFrame frame)
         //The user specified header.type is sent with the last fragment in the reserved field
         frame.header.type = frame.header.reserved;
         frame.header.reserved = 1;
+    #if defined(ENABLE_COMPRESSION)
+        frame.header.reserved |= compressed; // Decompressed by enqueue()
+    #endif
 
         //Append the received fragment to the cached frame
         memcpy(f->message_buffer + f->message_size, frame.message_buffer, frame.message_size);
@@ -413,31 +1253,133 @@ bool ESBNetwork<radio_t>::appendFragmentToFrame(RF24NetworkFrame frame)
     return false;
 }
 
+    #if defined(ENABLE_JUMBO_MESSAGES)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::appendJumboFragment(const RF24NetworkFrame& frame)
+{
+    if (frame.message_size < NETWORK_JUMBO_COUNT_SIZE) {
+        return false;
+    }
+    uint16_t fragments;
+    memcpy(&fragments, frame.message_buffer, NETWORK_JUMBO_COUNT_SIZE);
+    const uint8_t* data = frame.message_buffer + NETWORK_JUMBO_COUNT_SIZE;
+    uint16_t size = frame.message_size - NETWORK_JUMBO_COUNT_SIZE;
+    uint16_t from_node = frame.header.from_node;
+
+    if (frame.header.type == NETWORK_JUMBO_FIRST_FRAGMENT) {
+        typename std::map<uint16_t, jumboMessage>::iterator it = jumboFragmentsCache.find(from_node);
+        //Already rcvd first frag
+        if (it != jumboFragmentsCache.end() && it->second.header.id == frame.header.id) {
+            return false;
+        }
+        if (fragments < 2 || size > maxJumboSize) {
+            jumboFragmentsCache.erase(from_node);
+            return false;
+        }
+        jumboMessage& message = jumboFragmentsCache[from_node];
+        message.header = frame.header;
+        message.fragments = fragments;
+        message.buffer.assign(data, data + size);
+        return true;
+    }
+
+    typename std::map<uint16_t, jumboMessage>::iterator it = jumboFragmentsCache.find(from_node);
+    if (it == jumboFragmentsCache.end()) {
+        return false;
+    }
+    jumboMessage& message = it->second;
+    bool last = frame.header.type == NETWORK_JUMBO_LAST_FRAGMENT;
+    if (message.header.id != frame.header.id || fragments != message.fragments - 1 || last != (fragments == 1)) {
+        IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("%u: FRG Dropping jumbo fragment %u for frame with header id:%d, out of order fragment(s).\n"), millis(), fragments, frame.header.id););
+        return false;
+    }
+    if (message.buffer.size() + size > maxJumboSize) {
+        IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("%u: FRG Dropping jumbo message from 0%o, it exceeds %u bytes\n"), millis(), from_node, maxJumboSize););
+        jumboFragmentsCache.erase(it);
+        return false;
+    }
+    message.buffer.insert(message.buffer.end(), data, data + size);
+    message.fragments = fragments;
+    if (!last) {
+        return true;
+    }
+
+    // The message is delivered from the frameFragmentsCache, like a message of standard fragments
+    RF24NetworkFrame* f = &(frameFragmentsCache[from_node]);
+    f->header = frame.header;
+    f->header.type = frame.header.reserved;
+    f->header.reserved = 1;
+    f->message_size = message.buffer.size();
+    if (f->message_size <= sizeof(f->message_buffer)) {
+        memcpy(f->message_buffer, message.buffer.data(), f->message_size);
+    }
+    else {
+        // Too long for the frame, so the frame only holds the key of the payload
+        ++jumbo_key;
+        memcpy(f->message_buffer, &jumbo_key, sizeof(jumbo_key));
+        jumbo_payloads[jumbo_key].swap(message.buffer);
+    }
+    jumboFragmentsCache.erase(it);
+    return true;
+}
+    #endif // defined(ENABLE_JUMBO_MESSAGES)
+
 /******************************************************************/
 
 #else // Not defined RF24_Linux
 
 /******************************************************************/
 
-template<class radio_t>
-uint8_t ESBNetwork<radio_t>::enqueue(RF24NetworkHeader* header)
+template<class radio_t, class config_t>
+uint8_t ESBNetworkBase<radio_t, config_t>::enqueue(RF24NetworkHeader* header)
 {
     bool result = false;
     uint16_t message_size = frame_size - sizeof(RF24NetworkHeader);
 
     IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET Enqueue @%x\n"), next_frame - frame_queue));
 
+    #if defined(ENABLE_JUMBO_MESSAGES)
+    if (is_jumbo_fragment(header->type)) {
+        IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("Drop jumbo frag, only re-assembled on Linux\n")););
+        return false;
+    }
+    #endif
+
     #if !defined(DISABLE_FRAGMENTATION)
+        #if defined(ENABLE_SHARED_RX_BUFFER)
+    // Messages are re-assembled after the last queued frame
+    frag_queue.message_buffer = next_frame + 10;
+        #endif
 
-    bool isFragment = header->type == NETWORK_FIRST_FRAGMENT || header->type == NETWORK_MORE_FRAGMENTS || header->type == NETWORK_LAST_FRAGMENT;
+    bool isFragment = config_t::fragmentation && (header->type == NETWORK_FIRST_FRAGMENT || header->type == NETWORK_MORE_FRAGMENTS || header->type == NETWORK_LAST_FRAGMENT);
 
     if (isFragment) {
+        #if defined(ENABLE_FRAGMENT_STREAMING)
+        if (stream_fragment(*header, frame_buffer + sizeof(RF24NetworkHeader), message_size)) {
+            return true;
+        }
+        #endif
+        #if defined(ENABLE_COMPRESSION)
+        if (header->type == NETWORK_FIRST_FRAGMENT) {
+            frag_compressed = header->reserved & NETWORK_COMPRESSED_FRAGMENTS;
+            header->reserved &= ~NETWORK_COMPRESSED_FRAGMENTS;
+        }
+        #endif
 
         if (header->reserved < 2 && header->type != NETWORK_LAST_FRAGMENT) {
             return false;
         }
 
         if (header->type == NETWORK_FIRST_FRAGMENT) {
+        #if defined(ENABLE_SHARED_RX_BUFFER)
+            if (!frag_fits(message_size)) {
+                IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("Drop frag payload, queue full\n")););
+                frag_queue.header.reserved = 0;
+                return false;
+            }
+        #endif
 
             memcpy((char*)(&frag_queue), &frame_buffer, sizeof(RF24NetworkHeader));
             memcpy(frag_queue.message_buffer, frame_buffer + sizeof(RF24NetworkHeader), message_size);
@@ -452,7 +1394,7 @@ uint8_t ESBNetwork<radio_t>::enqueue(RF24NetworkHeader* header)
         // else if not first fragment
         else if (header->type == NETWORK_LAST_FRAGMENT || header->type == NETWORK_MORE_FRAGMENTS) {
 
-            if (frag_queue.message_size + message_size > MAX_PAYLOAD_SIZE) {
+            if (frag_queue.message_size + message_size > config_t::maxPayloadSize) {
         #if defined(RF24NETWORK_DEBUG_FRAGMENTATION) || defined(RF24NETWORK_DEBUG_MINIMAL)
                 printf_P(PSTR("Drop frag %d Size exceeds max\n\r"), header->reserved);
         #endif
@@ -465,6 +1407,13 @@ uint8_t ESBNetwork<radio_t>::enqueue(RF24NetworkHeader* header)
         #endif
                 return false;
             }
+        #if defined(ENABLE_SHARED_RX_BUFFER)
+            if (!frag_fits(frag_queue.message_size + message_size)) {
+                IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("Drop frag payload, queue full\n")););
+                frag_queue.header.reserved = 0;
+                return false;
+            }
+        #endif
 
             memcpy(frag_queue.message_buffer + frag_queue.message_size, frame_buffer + sizeof(RF24NetworkHeader), message_size);
             frag_queue.message_size += message_size;
@@ -475,6 +1424,20 @@ uint8_t ESBNetwork<radio_t>::enqueue(RF24NetworkHeader* header)
             }
             frag_queue.header.reserved = 0;
             frag_queue.header.type = header->reserved;
+        #if defined(ENABLE_COMPRESSION)
+            if (frag_compressed) {
+            #if defined(ENABLE_SHARED_RX_BUFFER)
+                uint16_t capacity = frame_queue + sizeof(frame_queue) - frag_queue.message_buffer;
+            #else
+                uint16_t capacity = sizeof(frag_queue_message_buffer);
+            #endif
+                frag_queue.message_size = lzss_decompress(frag_queue.message_buffer, frag_queue.message_size, capacity);
+                if (!frag_queue.message_size) {
+                    IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("Drop frag payload, decompression failed\n")););
+                    return false;
+                }
+            }
+        #endif
 
             IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("fq 3: %d\n"), frag_queue.message_size););
             IF_RF24NETWORK_DEBUG_FRAGMENTATION_L2(for (int i = 0; i < frag_queue.message_size; i++) { printf_P(PSTR("%02X"), frag_queue.message_buffer[i]); });
@@ -483,10 +1446,53 @@ uint8_t ESBNetwork<radio_t>::enqueue(RF24NetworkHeader* header)
             if (frag_queue.header.type == EXTERNAL_DATA_TYPE) {
                 return 2;
             }
-        #if defined(DISABLE_USER_PAYLOADS)
-            return 0;
+            if (!config_t::userPayloads) {
+                return 0;
+            }
+        #if defined(ENABLE_UNICAST_DEDUP)
+            if (is_unicast_duplicate(&frag_queue.header)) {
+                IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET Drop duplicate message from 0%o id %u\n"), frag_queue.header.from_node, frag_queue.header.id););
+                return true;
+            }
+        #endif
+        #if defined(ENABLE_TYPE_HANDLERS)
+            if (dispatch(frag_queue.header, frag_queue.message_buffer, frag_queue.message_size)) {
+                return true;
+            }
+        #endif
+        #if defined(ENABLE_FAIR_QUEUING) || defined(ENABLE_COALESCING)
+            // The older message is only replaced once this one is admitted, so a dropped message doesn't cost both
+            uint8_t* replaced = coalesce_find(frag_queue.header.from_node, frag_queue.header.type);
+        #endif
+        #if defined(ENABLE_FAIR_QUEUING)
+            if (!fair_allowed(frag_queue.header.from_node, frag_queue.message_size, replaced)) {
+                return false;
+            }
         #endif
-            if ((uint16_t)(MAX_PAYLOAD_SIZE) - (next_frame - frame_queue) >= frag_queue.message_size) {
+        #if defined(ENABLE_SHARED_RX_BUFFER)
+            #if defined(ENABLE_COALESCING)
+            coalesce_remove(replaced);
+            #endif
+            // The message is already in place, it only needs its header
+            memcpy(next_frame, &frag_queue, 10);
+            next_frame += (10 + frag_queue.message_size);
+            #if !defined(ARDUINO_ARCH_AVR)
+            if (uint8_t padding = (frag_queue.message_size + 10) % 4) {
+                next_frame += 4 - padding;
+            }
+            #endif
+            IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("enq size %d\n"), frag_queue.message_size););
+            return true;
+        #else
+            #if defined(ENABLE_COALESCING)
+            uint16_t replaced_size = replaced ? queued_size(replaced) : 0;
+            #else
+            const uint16_t replaced_size = 0;
+            #endif
+            if ((uint16_t)(config_t::maxPayloadSize) - (next_frame - frame_queue) + replaced_size >= frag_queue.message_size) {
+            #if defined(ENABLE_COALESCING)
+                coalesce_remove(replaced);
+            #endif
                 memcpy(next_frame, &frag_queue, 10);
                 memcpy(next_frame + 10, frag_queue.message_buffer, frag_queue.message_size);
                 next_frame += (10 + frag_queue.message_size);
@@ -500,6 +1506,7 @@ uint8_t ESBNetwork<radio_t>::enqueue(RF24NetworkHeader* header)
             }
             IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("Drop frag payload, queue full\n")););
             return false;
+        #endif
 
         } //If more or last fragments
     }
@@ -508,28 +1515,82 @@ uint8_t ESBNetwork<radio_t>::enqueue(RF24NetworkHeader* header)
 
     // Copy the current frame into the frame queue
     #if !defined(DISABLE_FRAGMENTATION)
-        if (header->type == EXTERNAL_DATA_TYPE)
+        if (config_t::fragmentation && header->type == EXTERNAL_DATA_TYPE)
     {
+        #if defined(ENABLE_SHARED_RX_BUFFER)
+        if (!frag_fits(message_size)) {
+            IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET **Drop Payload** Buffer Full")));
+            return false;
+        }
+        #endif
         memcpy((char*)(&frag_queue), &frame_buffer, 8);
         memcpy(frag_queue.message_buffer, frame_buffer + sizeof(RF24NetworkHeader), message_size);
         frag_queue.message_size = message_size;
+        #if defined(ENABLE_SHARED_RX_BUFFER)
+        frag_queue.header.reserved = 0; // Any message being re-assembled was overwritten
+        #endif
         return 2;
     }
     #endif
-    #if defined(DISABLE_USER_PAYLOADS)
-    return 0;
-}
-    #else // !defined(DISABLE_USER_PAYLOADS)
-        #if !defined(ARDUINO_ARCH_AVR)
+    if (!config_t::userPayloads) {
+        return 0;
+    }
+    #if defined(ENABLE_UNICAST_DEDUP)
+    if (is_unicast_duplicate(header)) {
+        IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET Drop duplicate message from 0%o id %u\n"), header->from_node, header->id););
+        return true;
+    }
+    #endif
+    #if defined(ENABLE_TYPE_HANDLERS)
+    if (dispatch(*header, frame_buffer + sizeof(RF24NetworkHeader), message_size)) {
+        return true;
+    }
+    #endif
+    #if defined(ENABLE_FAIR_QUEUING) || defined(ENABLE_COALESCING)
+    // The older message is only replaced once this one is admitted, so a dropped message doesn't cost both
+    uint8_t* replaced = coalesce_find(header->from_node, header->type);
+    #endif
+    #if defined(ENABLE_FAIR_QUEUING)
+    if (!fair_allowed(header->from_node, message_size, replaced)) {
+        return false;
+    }
+    #endif
+    #if defined(ENABLE_COALESCING)
+    uint16_t replaced_size = replaced ? queued_size(replaced) : 0;
+    #else
+    const uint16_t replaced_size = 0;
+    #endif
+    #if !defined(ARDUINO_ARCH_AVR)
     uint8_t padding = (message_size + 10) % 4;
     padding = padding ? 4 - padding : 0;
+    #endif
+    #if defined(ENABLE_SHARED_RX_BUFFER) && !defined(DISABLE_FRAGMENTATION)
+    if (frag_queue.header.reserved) {
+        // Move the message being re-assembled up, to queue this frame in front of it
+        uint16_t frame_len = message_size + 10;
+        #if !defined(ARDUINO_ARCH_AVR)
+        frame_len += padding;
+        #endif
+        if (frag_fits(frame_len + frag_queue.message_size)) {
+            memmove(frag_queue.message_buffer + frame_len, frag_queue.message_buffer, frag_queue.message_size);
+        }
+        else {
+            IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("Drop partial frag payload, queue full\n")););
+            frag_queue.header.reserved = 0;
+        }
+    }
+    #endif
+    #if !defined(ARDUINO_ARCH_AVR)
     if (padding +
-        #else
+    #else
     if (
-        #endif
+    #endif
             message_size + 10 + (next_frame - frame_queue)
-        <= MAIN_BUFFER_SIZE)
+        <= (uint16_t)sizeof(frame_queue) + replaced_size)
     {
+    #if defined(ENABLE_COALESCING)
+        coalesce_remove(replaced);
+    #endif
         memcpy(next_frame, &frame_buffer, 8);
         memcpy(next_frame + 8, &message_size, 2);
         memcpy(next_frame + 10, frame_buffer + 8, message_size);
@@ -537,9 +1598,9 @@ uint8_t ESBNetwork<radio_t>::enqueue(RF24NetworkHeader* header)
         //IF_RF24NETWORK_DEBUG_FRAGMENTATION( for(int i=0; i<message_size;i++){ Serial.print(next_frame[i],HEX); Serial.print(" : "); } Serial.println(""); );
 
         next_frame += (message_size + 10);
-        #if !defined(ARDUINO_ARCH_AVR)
+    #if !defined(ARDUINO_ARCH_AVR)
         next_frame += padding;
-        #endif
+    #endif
         //IF_RF24NETWORK_DEBUG_FRAGMENTATION( Serial.print("Enq "); Serial.println(next_frame-frame_queue); );//printf_P(PSTR("enq %d\n"),next_frame-frame_queue); );
 
         result = true;
@@ -550,97 +1611,1318 @@ uint8_t ESBNetwork<radio_t>::enqueue(RF24NetworkHeader* header)
     }
     return result;
 }
-    #endif //USER_PAYLOADS_ENABLED
 
-#endif //End not defined RF24_Linux
+    #if defined(ENABLE_FAIR_QUEUING) || defined(ENABLE_COALESCING)
 /******************************************************************/
 
-template<class radio_t>
-bool ESBNetwork<radio_t>::available(void)
+template<class radio_t, class config_t>
+uint16_t ESBNetworkBase<radio_t, config_t>::queued_size(const uint8_t* frame)
 {
-#if defined(RF24_LINUX)
-    return (!frame_queue.empty());
-#else
-    // Are there frames on the queue for us?
-    return (next_frame > frame_queue);
-#endif
+    uint16_t size;
+    memcpy(&size, frame + 8, 2);
+    size += 10;
+        #if !defined(ARDUINO_ARCH_AVR)
+    if (size % 4) {
+        size += 4 - size % 4;
+    }
+        #endif
+    return size;
 }
 
 /******************************************************************/
 
-template<class radio_t>
-uint16_t ESBNetwork<radio_t>::parent() const
+template<class radio_t, class config_t>
+uint8_t* ESBNetworkBase<radio_t, config_t>::coalesce_find(uint16_t from_node, uint8_t type)
 {
-    if (node_address == 0)
-        return -1;
-    else
-        return parent_node;
+        #if defined(ENABLE_COALESCING)
+    if (isCoalesced(type)) {
+        for (uint8_t* frame = frame_queue; frame < next_frame; frame += queued_size(frame)) {
+            RF24NetworkHeader* header = (RF24NetworkHeader*)frame;
+            if (header->from_node == from_node && header->type == type) {
+                return frame;
+            }
+        }
+    }
+        #else
+    (void)from_node;
+    (void)type;
+        #endif
+    return NULL;
 }
+    #endif // defined(ENABLE_FAIR_QUEUING) || defined(ENABLE_COALESCING)
 
+    #if defined(ENABLE_COALESCING)
 /******************************************************************/
 
-template<class radio_t>
-uint16_t ESBNetwork<radio_t>::peek(RF24NetworkHeader& header)
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::coalesce_remove(uint8_t* frame)
 {
-    if (available()) {
-#if defined(RF24_LINUX)
-        RF24NetworkFrame frame = frame_queue.front();
-        memcpy(&header, &frame.header, sizeof(RF24NetworkHeader));
-        return frame.message_size;
-#else
-        RF24NetworkFrame* frame = (RF24NetworkFrame*)(frame_queue);
-        memcpy(&header, &frame->header, sizeof(RF24NetworkHeader));
-        uint16_t msg_size;
-        memcpy(&msg_size, frame_queue + 8, 2);
-        return msg_size;
-#endif
+    if (!frame) {
+        return;
     }
-    return 0;
+    IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET Replacing unread message from 0%o type %d\n"), ((RF24NetworkHeader*)frame)->from_node, ((RF24NetworkHeader*)frame)->type););
+    // The rest of the buffer moves down, including a message being re-assembled after the queued frames
+    uint16_t size = queued_size(frame);
+    memmove(frame, frame + size, frame_queue + sizeof(frame_queue) - (frame + size));
+    next_frame -= size;
+        #if defined(ENABLE_SHARED_RX_BUFFER) && !defined(DISABLE_FRAGMENTATION)
+    frag_queue.message_buffer = next_frame + 10;
+        #endif
+        #if defined(ENABLE_FAIR_QUEUING)
+    if (fair_head == frame) {
+        fair_head = NULL;
+    }
+    else if (fair_head > frame) {
+        fair_head -= size;
+    }
+        #endif
 }
+    #endif // defined(ENABLE_COALESCING)
 
+    #if defined(ENABLE_FAIR_QUEUING)
 /******************************************************************/
 
-template<class radio_t>
-void ESBNetwork<radio_t>::peek(RF24NetworkHeader& header, void* message, uint16_t maxlen)
+template<class radio_t, class config_t>
+uint8_t* ESBNetworkBase<radio_t, config_t>::fair_find(uint8_t source)
 {
-    if (available()) {
-#if defined(RF24_LINUX)
-        RF24NetworkFrame frame = frame_queue.front();
-        memcpy(&header, &(frame.header), sizeof(RF24NetworkHeader));
-        if (maxlen > 0) {
-            maxlen = rf24_min(frame.message_size, maxlen);
-            memcpy(message, frame.message_buffer, maxlen);
-        }
-#else
-        memcpy(&header, frame_queue, 8); //Copy the header
-        if (maxlen > 0) {
-            uint16_t bufsize = 0;
-            memcpy(&bufsize, frame_queue + 8, 2);
-            maxlen = rf24_min(bufsize, maxlen);
-            memcpy(message, frame_queue + 10, maxlen); //Copy the message
+    for (uint8_t* frame = frame_queue; frame < next_frame; frame += queued_size(frame)) {
+        if (fair_source(((RF24NetworkHeader*)frame)->from_node) == source) {
+            return frame;
         }
-#endif
     }
+    return NULL;
 }
 
 /******************************************************************/
 
-template<class radio_t>
-uint16_t ESBNetwork<radio_t>::read(RF24NetworkHeader& header, void* message, uint16_t maxlen)
+template<class radio_t, class config_t>
+uint16_t ESBNetworkBase<radio_t, config_t>::fair_space(uint16_t from_node, const uint8_t* replaced)
 {
-    uint16_t bufsize = 0;
-
-    // This function assumes that there is a frame in the queue.
-    // Call `available()` before calling `read()`.
-    //if (!available()) { return bufsize; }
+    uint8_t source = fair_source(from_node);
+    uint16_t used = 0;
+    for (uint8_t* frame = frame_queue; frame < next_frame; frame += queued_size(frame)) {
+        if (frame != replaced && fair_source(((RF24NetworkHeader*)frame)->from_node) == source) {
+            used += queued_size(frame);
+        }
+    }
+    // A source without queued messages can always queue one, even if it's larger than its share
+    if (!maxSourceQueue || !used) {
+        return 0xFFFF;
+    }
+    return used < maxSourceQueue ? maxSourceQueue - used : 0;
+}
 
-#if defined(RF24_LINUX)
-    RF24NetworkFrame frame = frame_queue.front();
+/******************************************************************/
 
-    // How much buffer size should we actually copy?
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::fair_allowed(uint16_t from_node, uint16_t len, const uint8_t* replaced)
+{
+    if (fair_space(from_node, replaced) < len + 10) {
+        IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET **Drop Payload** from 0%o, its source holds its share\n"), from_node););
+        return false;
+    }
+    return true;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+uint32_t ESBNetworkBase<radio_t, config_t>::fair_head_size(uint8_t source)
+{
+    uint8_t* frame = fair_find(source);
+    return frame ? queued_size(frame) : 0;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::fair_stage(void)
+{
+    if (!fair_head) {
+        fair_head = fair_find(fair_select());
+    }
+}
+    #endif // defined(ENABLE_FAIR_QUEUING)
+
+#endif //End not defined RF24_Linux
+
+#if defined(ENABLE_FAIR_QUEUING)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+uint8_t ESBNetworkBase<radio_t, config_t>::fair_select(void)
+{
+    bool waiting = false;
+    for (uint8_t source = 0; source < NUM_PIPES; ++source) {
+        waiting |= fair_head_size(source) > 0;
+    }
+    if (!waiting) {
+        return NUM_PIPES;
+    }
+
+    // Each source gets a quantum per turn, and is served while its deficit covers its next message
+    while (true) {
+        uint32_t size = fair_head_size(fair_next);
+        if (!size) {
+            fair_deficit[fair_next] = 0;
+        }
+        else {
+            if (fair_fresh) {
+                fair_deficit[fair_next] += NETWORK_FAIR_QUANTUM;
+                fair_fresh = false;
+            }
+            if (size <= fair_deficit[fair_next]) {
+                fair_deficit[fair_next] -= size;
+                return fair_next;
+            }
+        }
+        fair_next = (fair_next + 1) % NUM_PIPES;
+        fair_fresh = true;
+    }
+}
+
+#endif // defined(ENABLE_FAIR_QUEUING)
+
+#if defined(ENABLE_UNICAST_DEDUP)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::is_unicast_duplicate(RF24NetworkHeader* header)
+{
+    // Messages to self and multicast messages don't pass through the filter
+    if (header->from_node == node_address || header->to_node == NETWORK_MULTICAST_ADDRESS) {
+        return false;
+    }
+
+    uint32_t now = millis();
+    unicastDedupEntry* entry = NULL;
+    for (uint8_t i = 0; i < UNICAST_DEDUP_SOURCES; ++i) {
+        if (unicast_dedup[i].node == header->from_node) {
+            entry = &unicast_dedup[i];
+            break;
+        }
+    }
+
+    if (entry == NULL || now - entry->time > UNICAST_DEDUP_TIMEOUT) {
+        if (entry == NULL) {
+            entry = &unicast_dedup[unicast_dedup_next];
+            unicast_dedup_next = (unicast_dedup_next + 1) % UNICAST_DEDUP_SOURCES;
+        }
+        entry->node = header->from_node;
+        entry->last_id = header->id;
+        entry->window = 0;
+        entry->time = now;
+        return false;
+    }
+    entry->time = now;
+
+    uint16_t ahead = header->id - entry->last_id;
+    if (ahead == 0) {
+        ++unicast_duplicates;
+        return true;
+    }
+    if (ahead < 0x8000) {
+        // A newer ID; slide the window forward, marking the previous newest ID as received
+        if (ahead > 32) {
+            entry->window = 0;
+        }
+        else {
+            entry->window = (ahead == 32 ? 0 : entry->window << ahead) | (1UL << (ahead - 1));
+        }
+        entry->last_id = header->id;
+        return false;
+    }
+
+    uint16_t behind = entry->last_id - header->id;
+    if (behind > 32) {
+        // Too old to be a retransmission, so the source most likely restarted its IDs
+        entry->last_id = header->id;
+        entry->window = 0;
+        return false;
+    }
+    uint32_t bit = 1UL << (behind - 1);
+    if (entry->window & bit) {
+        ++unicast_duplicates;
+        return true;
+    }
+    entry->window |= bit;
+    return false;
+}
+
+#endif // defined(ENABLE_UNICAST_DEDUP)
+#if defined(ENABLE_TYPE_HANDLERS)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::setHandler(uint8_t type, RF24NetworkHandler handler, void* context)
+{
+    // These types are handled internally
+    if (type == NETWORK_ACK || type == EXTERNAL_DATA_TYPE || type == NETWORK_FIRST_FRAGMENT || type == NETWORK_MORE_FRAGMENTS || type == NETWORK_LAST_FRAGMENT || is_jumbo_fragment(type)) {
+        return false;
+    }
+    #if NETWORK_HANDLER_TYPES < 256
+    if (type >= NETWORK_HANDLER_TYPES) {
+        return false;
+    }
+    #endif
+    handlers[type].handler = handler;
+    handlers[type].context = context;
+    return true;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::dispatch(RF24NetworkHeader& header, const uint8_t* message, uint16_t len)
+{
+    if (has_handler(header.type)) {
+        // The handler gets its own copy of the header, which write() can't overwrite
+        RF24NetworkHeader handlerHeader = header;
+        handlers[header.type].handler(handlerHeader, message, len, handlers[header.type].context);
+        return true;
+    }
+    if ((networkFlags & FLAG_DROP_UNHANDLED) && header.type <= MAX_USER_DEFINED_HEADER_TYPE) {
+        IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET Drop unhandled message type %d from 0%o\n"), header.type, header.from_node););
+        return true;
+    }
+    return false;
+}
+
+#endif // defined(ENABLE_TYPE_HANDLERS)
+#if defined(ENABLE_FRAGMENT_STREAMING)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::setFragmentHandler(RF24NetworkFragmentHandler handler, void* context)
+{
+    fragment_handler = handler;
+    fragment_context = context;
+    stream_active = false;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::stream_abort(void)
+{
+    IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("FRG Stream from 0%o id %u aborted after %u bytes\n\r"), stream_header.from_node, stream_header.id, stream_size););
+    stream_active = false;
+    fragment_handler(RF24NETWORK_FRAGMENT_ABORT, stream_header, NULL, stream_size, fragment_context);
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::stream_fragment(RF24NetworkHeader header, const uint8_t* payload, uint16_t size)
+{
+    if (!fragment_handler || !config_t::fragmentation) {
+        return false;
+    }
+
+    if (header.type == NETWORK_FIRST_FRAGMENT) {
+        if (stream_active) {
+            // One message is streamed at a time, the others are re-assembled as usual
+            if (header.from_node != stream_header.from_node) {
+                return false;
+            }
+            if (header.id == stream_header.id) {
+                return true; // A repeated fragment
+            }
+            stream_abort();
+        }
+    #if defined(ENABLE_COMPRESSION)
+        if (header.reserved & NETWORK_COMPRESSED_FRAGMENTS) {
+            return false;
+        }
+    #endif
+        if (header.reserved < 2 || !fragment_handler(RF24NETWORK_FRAGMENT_START, header, NULL, 0, fragment_context)) {
+            return false;
+        }
+        stream_header = header;
+        stream_size = 0;
+        stream_active = true;
+    }
+    else if (header.type == NETWORK_MORE_FRAGMENTS || header.type == NETWORK_LAST_FRAGMENT) {
+        if (!stream_active || header.from_node != stream_header.from_node) {
+            return false;
+        }
+        bool next = header.id == stream_header.id && (header.type == NETWORK_LAST_FRAGMENT ? stream_header.reserved == 2 : header.reserved == stream_header.reserved - 1);
+        if (!next) {
+            if (header.id != stream_header.id || header.type == NETWORK_LAST_FRAGMENT || header.reserved != stream_header.reserved) {
+                stream_abort();
+            }
+            return true; // Dropped, or a repeated fragment
+        }
+        stream_header.reserved = header.reserved;
+    }
+    else {
+        return false;
+    }
+
+    stream_size += size;
+    stream_time = millis();
+    if (!fragment_handler(RF24NETWORK_FRAGMENT_CHUNK, header, payload, size, fragment_context)) {
+        stream_abort();
+        return true;
+    }
+    if (header.type == NETWORK_LAST_FRAGMENT) {
+        // The last fragment carries the message's type
+        header.type = header.reserved;
+        header.reserved = 0;
+        stream_active = false;
+        fragment_handler(RF24NETWORK_FRAGMENT_END, header, NULL, stream_size, fragment_context);
+    }
+    return true;
+}
+
+#endif // defined(ENABLE_FRAGMENT_STREAMING)
+#if defined(ENABLE_FLOW_CONTROL)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+typename ESBNetworkBase<radio_t, config_t>::flowControlEntry* ESBNetworkBase<radio_t, config_t>::flow_entry(flowControlEntry* table, uint16_t node)
+{
+    for (uint8_t i = 0; i < FLOW_CONTROL_NODES; i++) {
+        if (table[i].node == node) {
+            return &table[i];
+        }
+    }
+    return NULL;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::send_flow_control(uint16_t to_node, uint16_t pause, uint16_t credit)
+{
+    uint16_t message[2] = {pause, credit};
+    RF24NetworkHeader header(to_node, NETWORK_FLOW_CONTROL);
+    write(header, message, sizeof(message));
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::flow_control(uint16_t from_node)
+{
+    if (from_node == node_address) {
+        return;
+    }
+    #if defined(RF24_LINUX)
+    if (queued_frames() < FLOW_CONTROL_QUEUE_FRAMES) {
+        return;
+    }
+    uint16_t credit = 0;
+    #else
+    uint16_t credit = sizeof(frame_queue) - (next_frame - frame_queue);
+        #if defined(ENABLE_FAIR_QUEUING)
+    // The sender can only use the share of its source
+    credit = rf24_min(credit, fair_space(from_node, NULL));
+        #endif
+    if (credit >= FLOW_CONTROL_MIN_SPACE) {
+        return;
+    }
+    #endif
+
+    uint32_t now = millis();
+    flowControlEntry* entry = flow_entry(flow_pausing, from_node);
+    if (entry) {
+        // Frames already in flight keep arriving for a while, so don't repeat the pause right away
+        if (now - entry->time < FLOW_CONTROL_PAUSE / 2) {
+            return;
+        }
+    }
+    else {
+        // Use a free entry, or the oldest one (that sender is no longer resumed early)
+        entry = &flow_pausing[0];
+        for (uint8_t i = 0; i < FLOW_CONTROL_NODES; i++) {
+            if (flow_pausing[i].node == 0xFFFF) {
+                entry = &flow_pausing[i];
+                break;
+            }
+            if (now - flow_pausing[i].time > now - entry->time) {
+                entry = &flow_pausing[i];
+            }
+        }
+        entry->node = from_node;
+    }
+    entry->time = now;
+    IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET Buffer full, pausing 0%o (%u bytes free)\n\r"), from_node, credit););
+    send_flow_control(from_node, FLOW_CONTROL_PAUSE, credit);
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::flow_resume(void)
+{
+    #if defined(RF24_LINUX)
+    if (queued_frames() > FLOW_CONTROL_QUEUE_FRAMES / 2) {
+        return;
+    }
+    uint16_t credit = 0xFFFF;
+    #else
+    uint16_t credit = sizeof(frame_queue) - (next_frame - frame_queue);
+    if (credit < FLOW_CONTROL_RESUME_SPACE) {
+        return;
+    }
+    #endif
+
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < FLOW_CONTROL_NODES; i++) {
+        if (flow_pausing[i].node == 0xFFFF) {
+            continue;
+        }
+    #if defined(ENABLE_FAIR_QUEUING) && !defined(RF24_LINUX)
+        if (fair_space(flow_pausing[i].node, NULL) < FLOW_CONTROL_RESUME_SPACE) {
+            continue;
+        }
+    #endif
+        // Senders resume by themselves once the pause is over
+        if (now - flow_pausing[i].time < FLOW_CONTROL_PAUSE) {
+            IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET Resuming 0%o\n\r"), flow_pausing[i].node););
+            send_flow_control(flow_pausing[i].node, 0, credit);
+        }
+        flow_pausing[i].node = 0xFFFF;
+    }
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::flow_received(RF24NetworkHeader* header)
+{
+    uint16_t message[2];
+    if (frame_size < sizeof(RF24NetworkHeader) + sizeof(message)) {
+        return;
+    }
+    memcpy(message, frame_buffer + sizeof(RF24NetworkHeader), sizeof(message));
+
+    flowControlEntry* entry = flow_entry(flow_paused, header->from_node);
+    if (!message[0]) {
+        if (entry) {
+            entry->node = 0xFFFF;
+        }
+        return;
+    }
+    if (!entry) {
+        entry = flow_entry(flow_paused, 0xFFFF);
+    }
+    if (!entry) {
+        // Replace the pause that ends first
+        entry = &flow_paused[0];
+        for (uint8_t i = 1; i < FLOW_CONTROL_NODES; i++) {
+            if ((int32_t)(flow_paused[i].time - entry->time) < 0) {
+                entry = &flow_paused[i];
+            }
+        }
+    }
+    entry->node = header->from_node;
+    entry->time = millis() + message[0];
+    entry->credit = message[1];
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::flow_allowed(uint16_t to_node, uint16_t len)
+{
+    flowControlEntry* entry = flow_entry(flow_paused, to_node);
+    if (!entry) {
+        return true;
+    }
+    if ((int32_t)(millis() - entry->time) >= 0) {
+        entry->node = 0xFFFF; // The pause is over
+        return true;
+    }
+    // Messages are stored with a 10 byte header (plus up to 3 bytes of padding)
+    uint16_t size = len + 10 + 3;
+    if (size > entry->credit) {
+        return false;
+    }
+    entry->credit -= size;
+    return true;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::isPaused(uint16_t to_node)
+{
+    flowControlEntry* entry = flow_entry(flow_paused, to_node);
+    return entry && (int32_t)(millis() - entry->time) < 0;
+}
+
+#endif // defined(ENABLE_FLOW_CONTROL)
+#if defined(ENABLE_COMPACT_FRAGMENTS)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+uint8_t ESBNetworkBase<radio_t, config_t>::link_index(uint16_t node)
+{
+    if (node_address && node == parent_node) {
+        return 0;
+    }
+    if (node != node_address && is_descendant(node) && is_direct_child(node)) {
+        // The child's pipe is the digit after this node's address
+        uint16_t m = node_mask;
+        while (m) {
+            node >>= 3;
+            m >>= 3;
+        }
+        return node & 0x07;
+    }
+    return 0xFF;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::compact_store(compactContext* table, uint8_t& next, const compactContext& context)
+{
+    // A source sends one fragmented message at a time, so its next message replaces the previous one.
+    // Messages from other sources are kept even if they share the low byte of the ID (see compact_match())
+    uint8_t slot = next;
+    for (uint8_t i = 0; i < NETWORK_COMPACT_CONTEXTS; ++i) {
+        if (table[i].link == context.link && table[i].from_node == context.from_node) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot == next) {
+        next = (next + 1) % NETWORK_COMPACT_CONTEXTS;
+    }
+    table[slot] = context;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+typename ESBNetworkBase<radio_t, config_t>::compactContext* ESBNetworkBase<radio_t, config_t>::compact_match(compactContext* table, uint8_t link, uint8_t id)
+{
+    // Compact headers only carry the low byte of the message ID
+    compactContext* match = NULL;
+    for (uint8_t i = 0; i < NETWORK_COMPACT_CONTEXTS; ++i) {
+        if (table[i].link == link && (uint8_t)table[i].id == id) {
+            if (match) {
+                return NULL;
+            }
+            match = &table[i];
+        }
+    }
+    return match;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+uint8_t ESBNetworkBase<radio_t, config_t>::compact_frame(uint16_t node, uint8_t* compact)
+{
+    RF24NetworkHeader* header = (RF24NetworkHeader*)(&frame_buffer);
+    uint8_t link = link_index(node);
+    if (link == 0xFF || !(compact_links & (1 << link))) {
+        return 0;
+    }
+
+    if (header->type == NETWORK_FIRST_FRAGMENT) {
+        // The neighbor only knows the message if it expects it over this link (see update())
+        if (node == parent_node ? is_descendant(header->from_node) : !(is_descendant(header->from_node) && direct_child_route_to(header->from_node) == node)) {
+            compactContext context = {header->from_node, header->to_node, header->id, link};
+            compact_store(compact_tx, compact_tx_next, context);
+        }
+        return 0;
+    }
+    if (header->type != NETWORK_MORE_FRAGMENTS && header->type != NETWORK_LAST_FRAGMENT) {
+        return 0;
+    }
+
+    uint8_t size = 0;
+    for (uint8_t i = 0; i < NETWORK_COMPACT_CONTEXTS; ++i) {
+        compactContext* context = &compact_tx[i];
+        if (context->link == link && context->from_node == header->from_node && context->to_node == header->to_node && context->id == header->id) {
+            // The full header is sent while another message over this link shares the low byte of the ID
+            if (compact_match(compact_tx, link, header->id) == context) {
+                compact[0] = header->id;
+                compact[1] = 0xF0 | (header->type == NETWORK_LAST_FRAGMENT ? 0x08 : 0) | (node == parent_node ? parent_pipe : 0);
+                compact[2] = header->reserved;
+                memcpy(compact + NETWORK_COMPACT_HEADER_SIZE, frame_buffer + sizeof(RF24NetworkHeader), frame_size - sizeof(RF24NetworkHeader));
+                size = frame_size - NETWORK_COMPACT_SAVING;
+            }
+            if (header->type == NETWORK_LAST_FRAGMENT) {
+                context->link = 0xFF; // The neighbor forgets the message too
+            }
+            break;
+        }
+    }
+    return size;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::expand_frame(void)
+{
+    uint8_t link = frame_buffer[1] & 0x07;
+    // Dropped if more than one message over this link shares the low byte of the ID
+    compactContext* context = compact_match(compact_rx, link, frame_buffer[0]);
+    if (!context) {
+        return false;
+    }
+
+    uint8_t last = frame_buffer[1] & 0x08;
+    uint8_t reserved = frame_buffer[2];
+    memmove(frame_buffer + sizeof(RF24NetworkHeader), frame_buffer + NETWORK_COMPACT_HEADER_SIZE, frame_size - NETWORK_COMPACT_HEADER_SIZE);
+    frame_size += NETWORK_COMPACT_SAVING;
+
+    RF24NetworkHeader* header = (RF24NetworkHeader*)(&frame_buffer);
+    header->from_node = context->from_node;
+    header->to_node = context->to_node;
+    header->id = context->id;
+    header->type = last ? NETWORK_LAST_FRAGMENT : NETWORK_MORE_FRAGMENTS;
+    header->reserved = reserved;
+    if (last) {
+        context->link = 0xFF;
+    }
+
+    // A neighbor that sends compact headers also understands them
+    compact_links |= 1 << link;
+    return true;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::send_compact_hello(uint16_t to_node, uint8_t request)
+{
+    RF24NetworkHeader header(to_node, NETWORK_COMPACT_HELLO);
+    write(header, &request, 1);
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::compact_route(uint16_t to_node, uint16_t writeDirect)
+{
+    if (writeDirect != NETWORK_AUTO_ROUTING || to_node == NETWORK_MULTICAST_ADDRESS) {
+        return false;
+    }
+    logicalToPhysicalStruct conversion = {to_node, TX_NORMAL, 0};
+    logicalToPhysicalAddress(&conversion);
+    uint8_t link = link_index(conversion.send_node);
+    if (link == 0xFF || !(compact_links & (1 << link))) {
+        return false;
+    }
+    // Relays drop continuation fragments that are too large for a full header
+    return conversion.send_node == to_node || (networkFlags & FLAG_COMPACT_ROUTES);
+}
+
+#endif // defined(ENABLE_COMPACT_FRAGMENTS)
+#if defined(ENABLE_AGGREGATION)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::aggregate(RF24NetworkHeader& header, const void* message, uint16_t len, uint16_t writeDirect)
+{
+    RF24NetworkHeader* pending = (RF24NetworkHeader*)aggregate_tx;
+
+    // Only small user messages that don't wait for a NETWORK_ACK are held back
+    uint16_t next_node = NETWORK_MULTICAST_ADDRESS;
+    if (aggregateDelay && writeDirect == NETWORK_AUTO_ROUTING && header.type <= MAX_USER_DEFINED_HEADER_TYPE && len <= (max_frame_payload_size - NETWORK_AGGREGATE_SUBHEADER_SIZE * 2) / 2
+        && node_address != NETWORK_DEFAULT_ADDRESS && header.to_node != node_address && header.to_node != NETWORK_MULTICAST_ADDRESS && is_valid_address(header.to_node)) {
+        logicalToPhysicalStruct conversion = {header.to_node, TX_NORMAL, 0};
+        logicalToPhysicalAddress(&conversion);
+        if (conversion.send_node == header.to_node || header.type <= 64) {
+            next_node = conversion.send_node;
+        }
+    }
+
+    // Messages are kept in order, and the sub-messages need consecutive IDs
+    uint8_t limit = max_frame_payload_size + sizeof(RF24NetworkHeader);
+    if (aggregate_tx_size && (next_node != pending->to_node || header.id != (uint16_t)(pending->id + pending->reserved) || aggregate_tx_size + NETWORK_AGGREGATE_SUBHEADER_SIZE + len > limit)) {
+        flushAggregate();
+    }
+    if (next_node == NETWORK_MULTICAST_ADDRESS) {
+        return false;
+    }
+
+    if (!aggregate_tx_size) {
+        pending->from_node = node_address;
+        pending->to_node = next_node;
+        pending->id = header.id;
+        pending->type = NETWORK_AGGREGATE;
+        pending->reserved = 0;
+        aggregate_tx_size = sizeof(RF24NetworkHeader);
+        aggregate_tx_time = millis();
+    }
+
+    header.from_node = node_address;
+    uint8_t* sub = aggregate_tx + aggregate_tx_size;
+    memcpy(sub, &header.to_node, sizeof(header.to_node));
+    sub[2] = header.type;
+    sub[3] = len;
+    memcpy(sub + NETWORK_AGGREGATE_SUBHEADER_SIZE, message, len);
+    aggregate_tx_size += NETWORK_AGGREGATE_SUBHEADER_SIZE + len;
+    pending->reserved++;
+    IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET Holding message %u to 0%o for aggregation\n\r"), header.id, header.to_node););
+
+    // Send it once no other small message fits
+    if (aggregate_tx_size + NETWORK_AGGREGATE_SUBHEADER_SIZE > limit) {
+        flushAggregate();
+    }
+    return true;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::flushAggregate(void)
+{
+    if (!aggregate_tx_size) {
+        return true;
+    }
+
+    RF24NetworkHeader* header = (RF24NetworkHeader*)(&frame_buffer);
+    memcpy(frame_buffer, aggregate_tx, aggregate_tx_size);
+    frame_size = aggregate_tx_size;
+    aggregate_tx_size = 0;
+
+    uint16_t to_node = header->to_node;
+    if (header->reserved == 1) {
+        // A single message is sent with its own header
+        uint8_t* sub = frame_buffer + sizeof(RF24NetworkHeader);
+        memcpy(&header->to_node, sub, sizeof(header->to_node));
+        header->type = sub[2];
+        header->reserved = 0;
+        frame_size -= NETWORK_AGGREGATE_SUBHEADER_SIZE;
+        memmove(sub, sub + NETWORK_AGGREGATE_SUBHEADER_SIZE, frame_size - sizeof(RF24NetworkHeader));
+        to_node = header->to_node;
+    }
+    IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET Sending %u aggregated messages via 0%o\n\r"), header->type == NETWORK_AGGREGATE ? header->reserved : 1, to_node););
+    return write(to_node, TX_NORMAL);
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::unpack_aggregate(void)
+{
+    RF24NetworkHeader* aggregate = (RF24NetworkHeader*)aggregate_rx;
+    uint8_t* sub = aggregate_rx + aggregate_rx_pos;
+
+    // A malformed aggregate is dropped (the frame_size makes update() discard this frame)
+    frame_size = 0;
+    if (aggregate_rx_pos + NETWORK_AGGREGATE_SUBHEADER_SIZE > aggregate_rx_size || aggregate_rx_pos + NETWORK_AGGREGATE_SUBHEADER_SIZE + sub[3] > aggregate_rx_size || sub[2] > MAX_USER_DEFINED_HEADER_TYPE) {
+        aggregate_rx_size = 0;
+        return;
+    }
+
+    RF24NetworkHeader* header = (RF24NetworkHeader*)(&frame_buffer);
+    memcpy(frame_buffer, aggregate_rx, sizeof(RF24NetworkHeader));
+    memcpy(&header->to_node, sub, sizeof(header->to_node));
+    header->type = sub[2];
+    header->reserved = 0;
+    memcpy(frame_buffer + sizeof(RF24NetworkHeader), sub + NETWORK_AGGREGATE_SUBHEADER_SIZE, sub[3]);
+    frame_size = sizeof(RF24NetworkHeader) + sub[3];
+
+    aggregate->id++;
+    aggregate_rx_pos += NETWORK_AGGREGATE_SUBHEADER_SIZE + sub[3];
+    if (aggregate_rx_pos >= aggregate_rx_size) {
+        aggregate_rx_size = 0;
+    }
+}
+
+#endif // defined(ENABLE_AGGREGATION)
+#if defined(ENABLE_NEIGHBOR_ROUTES)
+/******************************************************************/
+
+// The number of octal digits (levels) of a logical address
+static inline uint8_t node_depth(uint16_t node)
+{
+    uint8_t depth = 0;
+    while (node) {
+        node >>= 3;
+        ++depth;
+    }
+    return depth;
+}
+
+/******************************************************************/
+
+// The number of hops between two nodes along the tree, through their common ancestor
+static inline uint8_t tree_hops(uint16_t a, uint16_t b)
+{
+    while (a && b && (a & 0x07) == (b & 0x07)) {
+        a >>= 3;
+        b >>= 3;
+    }
+    return node_depth(a) + node_depth(b);
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+uint16_t ESBNetworkBase<radio_t, config_t>::neighbor_route(uint16_t to_node)
+{
+    uint16_t route = NETWORK_MULTICAST_ADDRESS;
+    if (to_node == NETWORK_MULTICAST_ADDRESS) {
+        return route;
+    }
+
+    // Every hop on the way has a shorter tree route left, so a message can't loop
+    uint8_t hops = tree_hops(node_address, to_node);
+    uint8_t depth = node_depth(to_node);
+    for (uint8_t i = 0; i < NETWORK_NEIGHBORS; ++i) {
+        uint16_t neighbor = neighbors[i].node;
+        if (neighbor == NETWORK_MULTICAST_ADDRESS || !neighbors[i].reachable) {
+            continue;
+        }
+        uint8_t neighborDepth = node_depth(neighbor);
+        // The neighbor relays messages to its descendants down the tree
+        if (neighborDepth <= depth && (to_node & ((1 << (neighborDepth * 3)) - 1)) == neighbor && 1 + depth - neighborDepth < hops) {
+            hops = 1 + depth - neighborDepth;
+            route = neighbor;
+        }
+    }
+    return route;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::neighbor_store(uint16_t node, bool reachable)
+{
+    uint8_t slot = 0;
+    for (uint8_t i = 0; i < NETWORK_NEIGHBORS; ++i) {
+        if (neighbors[i].node == node || neighbors[i].node == NETWORK_MULTICAST_ADDRESS) {
+            slot = i;
+            break;
+        }
+        if ((int32_t)(neighbors[i].time - neighbors[slot].time) < 0) {
+            slot = i;
+        }
+    }
+    neighbors[slot].node = node;
+    neighbors[slot].time = millis();
+    neighbors[slot].reachable = reachable;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::neighbor_forget(uint16_t node)
+{
+    for (uint8_t i = 0; i < NETWORK_NEIGHBORS; ++i) {
+        if (neighbors[i].node == node && neighbors[i].reachable) {
+            neighbors[i].reachable = false;
+            neighbors[i].time = millis();
+            return true;
+        }
+    }
+    return false;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::neighbor_learn(uint16_t node)
+{
+    // The tree already links this node with its parent and children
+    if (node_address == NETWORK_DEFAULT_ADDRESS || node == node_address || node == parent_node || (is_descendant(node) && is_direct_child(node))) {
+        return;
+    }
+    for (uint8_t i = 0; i < NETWORK_NEIGHBORS; ++i) {
+        if (neighbors[i].node == node) {
+            if (neighbors[i].reachable || millis() - neighbors[i].time < NETWORK_NEIGHBOR_PROBE_INTERVAL) {
+                return;
+            }
+            break;
+        }
+    }
+    probeNeighbor(node);
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::probeNeighbor(uint16_t node)
+{
+    if (!is_valid_address(node) || node == node_address || node == NETWORK_MULTICAST_ADDRESS) {
+        return false;
+    }
+
+    RF24NetworkHeader header(node, NETWORK_NEIGHBOR_PROBE);
+    header.from_node = node_address;
+    memcpy(frame_buffer, &header, sizeof(RF24NetworkHeader));
+    frame_size = sizeof(RF24NetworkHeader);
+
+    // Sent on the node's listening pipe with auto-ack, so the radio tells if it is in range
+    bool ok = write_to_pipe(node, NUM_PIPES - 1, 0);
+    radio.startListening();
+    neighbor_store(node, ok);
+    IF_RF24NETWORK_DEBUG_ROUTING(printf_P(PSTR("MAC Neighbor 0%o %s\n\r"), node, ok ? "reached" : "not in range"););
+    return ok;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::isNeighbor(uint16_t node)
+{
+    for (uint8_t i = 0; i < NETWORK_NEIGHBORS; ++i) {
+        if (neighbors[i].node == node) {
+            return neighbors[i].reachable;
+        }
+    }
+    return false;
+}
+
+#endif // defined(ENABLE_NEIGHBOR_ROUTES)
+#if defined(ENABLE_ACK_PIGGYBACK)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::hold_ack(uint16_t to_node, uint16_t id)
+{
+    // The sender waits for one ACK at a time, so a newer one replaces a held ACK to the same node
+    uint8_t slot = 0xFF;
+    for (uint8_t i = 0; i < NETWORK_HELD_ACKS; ++i) {
+        if (held_acks[i].to_node == to_node) {
+            slot = i;
+            break;
+        }
+        if (slot == 0xFF && held_acks[i].to_node == NETWORK_MULTICAST_ADDRESS) {
+            slot = i;
+        }
+    }
+    if (slot == 0xFF) {
+        return false;
+    }
+    held_acks[slot].time = millis();
+    held_acks[slot].to_node = to_node;
+    held_acks[slot].id = id;
+    IF_RF24NETWORK_DEBUG_ROUTING(printf_P(PSTR("MAC Holding ACK for 0%o\n"), to_node););
+    return true;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+uint8_t ESBNetworkBase<radio_t, config_t>::held_ack(uint16_t to_node)
+{
+    for (uint8_t i = 0; i < NETWORK_HELD_ACKS; ++i) {
+        if (held_acks[i].to_node == to_node) {
+            return i;
+        }
+    }
+    return 0xFF;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::send_held_acks(void)
+{
+    for (uint8_t i = 0; i < NETWORK_HELD_ACKS; ++i) {
+        heldAck* held = &held_acks[i];
+        if (held->to_node == NETWORK_MULTICAST_ADDRESS || millis() - held->time < NETWORK_ACK_HOLD) {
+            continue;
+        }
+
+        // The same frame that write() sends after a routed delivery
+        RF24NetworkHeader* header = (RF24NetworkHeader*)(&frame_buffer);
+        header->from_node = held->to_node;
+        header->to_node = held->to_node;
+        header->id = held->id;
+        header->type = NETWORK_ACK;
+        header->reserved = 0;
+        frame_size = sizeof(RF24NetworkHeader);
+        held->to_node = NETWORK_MULTICAST_ADDRESS;
+
+        logicalToPhysicalStruct conversion = {header->to_node, TX_ROUTED, 0};
+        logicalToPhysicalAddress(&conversion);
+        write_to_pipe(conversion.send_node, conversion.send_pipe, conversion.multicast);
+        radio.startListening();
+        IF_RF24NETWORK_DEBUG_ROUTING(printf_P(PSTR("MAC Held ACK sent to 0%o\n"), header->to_node););
+    }
+}
+
+#endif // defined(ENABLE_ACK_PIGGYBACK)
+#if defined(ENABLE_TDMA)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::send_beacon(void)
+{
+    tdma_beacon_time = millis();
+    if (_multicast_level >= 4) {
+        return;
+    }
+
+    // The beacon's slot is followed by a slot for each active child, then the contention slots
+    uint8_t beacon[1 + NETWORK_TDMA_SLOTS];
+    uint8_t slots = 0;
+    beacon[0] = tdmaSlotTime;
+    for (uint8_t pipe = 1; pipe < NUM_PIPES; ++pipe) {
+        if (!(tdma_children & (1 << pipe))) {
+            continue;
+        }
+        if (tdma_beacon_time - tdma_heard[pipe] >= NETWORK_TDMA_IDLE) {
+            tdma_children &= ~(1 << pipe);
+        }
+        else if (slots < NETWORK_TDMA_SLOTS) {
+            beacon[1 + slots++] = pipe;
+        }
+    }
+    for (uint8_t i = 0; i < tdmaContentionSlots && slots < NETWORK_TDMA_SLOTS; ++i) {
+        beacon[1 + slots++] = 0;
+    }
+    tdma_beacon_slots = slots;
+
+    RF24NetworkHeader header(NETWORK_MULTICAST_ADDRESS, NETWORK_TDMA_BEACON);
+    multicast(header, beacon, 1 + slots, _multicast_level + 1);
+    IF_RF24NETWORK_DEBUG_ROUTING(printf_P(PSTR("MAC TDMA beacon with %d slots\n"), slots););
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::tdma_heard_from(uint16_t from_node)
+{
+    if (from_node == node_address) {
+        return;
+    }
+    uint8_t pipe = child_pipe(from_node);
+    if (pipe) {
+        tdma_heard[pipe] = millis();
+        tdma_children |= 1 << pipe;
+    }
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::tdma_sync(void)
+{
+    uint8_t slots = frame_size - sizeof(RF24NetworkHeader) - 1;
+    uint8_t* beacon = frame_buffer + sizeof(RF24NetworkHeader);
+    // A slot must leave a millisecond of guard time
+    if (frame_size <= sizeof(RF24NetworkHeader) || slots > NETWORK_TDMA_SLOTS || beacon[0] < 2) {
+        return;
+    }
+    tdma_frame_start = millis();
+    tdma_slot_time = beacon[0];
+    tdma_slots = slots;
+    memcpy(tdma_schedule, beacon + 1, slots);
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::tdma_wait(void)
+{
+    if (!isScheduled()) {
+        return;
+    }
+
+    // Children without a slot of their own use the contention slots
+    uint16_t frameLength = (tdma_slots + 1) * tdma_slot_time;
+    uint8_t pipe = memchr(tdma_schedule, parent_pipe, tdma_slots) ? parent_pipe : 0;
+    if (!pipe && !memchr(tdma_schedule, 0, tdma_slots)) {
+        return;
+    }
+    while (true) {
+        uint32_t elapsed = millis() - tdma_frame_start;
+        if (elapsed > (uint32_t)frameLength * NETWORK_TDMA_MISSED_BEACONS) {
+            tdma_slots = 0;
+            return;
+        }
+        uint16_t offset = elapsed % frameLength;
+        uint8_t slot = offset / tdma_slot_time;
+        // The schedule follows the beacon's slot, and the last millisecond of each slot is a guard time
+        if (slot && tdma_schedule[slot - 1] == pipe && offset % tdma_slot_time < tdma_slot_time - 1) {
+            return;
+        }
+        delay(1);
+    }
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::isScheduled(void)
+{
+    if (tdma_slots && millis() - tdma_frame_start > (uint32_t)(tdma_slots + 1) * tdma_slot_time * NETWORK_TDMA_MISSED_BEACONS) {
+        IF_RF24NETWORK_DEBUG_ROUTING(printf_P(PSTR("MAC TDMA beacons missed, contending for the parent\n")););
+        tdma_slots = 0;
+    }
+    return tdma_slots;
+}
+
+#endif // defined(ENABLE_TDMA)
+#if defined(ENABLE_GATEWAY)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::routeSubtree(uint8_t child, ESBNetworkBase<radio_t, config_t>* network)
+{
+    if (child && child < NUM_PIPES) {
+        gateway_routes[child] = network;
+    }
+}
+
+#endif // defined(ENABLE_GATEWAY)
+#if defined(ENABLE_CAPTURE)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::setCapture(RF24NetworkCaptureHandler handler, void* context)
+{
+    capture_handler = handler;
+    capture_context = context;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::capture(const uint8_t* frame, uint8_t size, uint16_t node, uint8_t pipe, uint8_t flags, uint32_t time)
+{
+    if (!capture_handler) {
+        return;
+    }
+    RF24NetworkCapture record;
+    record.time = time;
+    record.duration = flags & RF24NETWORK_CAPTURE_TX ? micros() - time : 0;
+    record.frame = frame;
+    record.node = node;
+    record.size = size;
+    record.pipe = pipe;
+    record.flags = flags;
+    capture_handler(record, capture_context);
+}
+
+#endif // defined(ENABLE_CAPTURE)
+#if defined(ENABLE_COALESCING)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::setCoalescing(uint8_t type, bool enable)
+{
+    if (enable) {
+        coalesce_types[type >> 3] |= 1 << (type & 7);
+    }
+    else {
+        coalesce_types[type >> 3] &= ~(1 << (type & 7));
+    }
+}
+
+#endif // defined(ENABLE_COALESCING)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::available(void)
+{
+#if defined(RF24_LINUX)
+    return queued_frames();
+#else
+    // Are there frames on the queue for us?
+    return (next_frame > frame_queue);
+#endif
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+uint16_t ESBNetworkBase<radio_t, config_t>::parent() const
+{
+    if (node_address == 0)
+        return -1;
+    else
+        return parent_node;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+uint16_t ESBNetworkBase<radio_t, config_t>::peek(RF24NetworkHeader& header)
+{
+    if (available()) {
+#if defined(ENABLE_FAIR_QUEUING)
+        fair_stage();
+#endif
+#if defined(RF24_LINUX)
+        const RF24NetworkFrame& frame = frame_queue.front();
+        memcpy(&header, &frame.header, sizeof(RF24NetworkHeader));
+        return frame.message_size;
+#else
+    #if defined(ENABLE_FAIR_QUEUING)
+        uint8_t* head = fair_head;
+    #else
+        uint8_t* head = frame_queue;
+    #endif
+        RF24NetworkFrame* frame = (RF24NetworkFrame*)(head);
+        memcpy(&header, &frame->header, sizeof(RF24NetworkHeader));
+        uint16_t msg_size;
+        memcpy(&msg_size, head + 8, 2);
+        return msg_size;
+#endif
+    }
+    return 0;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::peek(RF24NetworkHeader& header, void* message, uint16_t maxlen)
+{
+    if (available()) {
+#if defined(ENABLE_FAIR_QUEUING)
+        fair_stage();
+#endif
+#if defined(RF24_LINUX)
+        const RF24NetworkFrame& frame = frame_queue.front();
+        memcpy(&header, &(frame.header), sizeof(RF24NetworkHeader));
+        if (maxlen > 0) {
+            maxlen = rf24_min(frame.message_size, maxlen);
+            memcpy(message, frame_payload(frame), maxlen);
+        }
+#else
+    #if defined(ENABLE_FAIR_QUEUING)
+        uint8_t* head = fair_head;
+    #else
+        uint8_t* head = frame_queue;
+    #endif
+        memcpy(&header, head, 8); //Copy the header
+        if (maxlen > 0) {
+            uint16_t bufsize = 0;
+            memcpy(&bufsize, head + 8, 2);
+            maxlen = rf24_min(bufsize, maxlen);
+            memcpy(message, head + 10, maxlen); //Copy the message
+        }
+#endif
+    }
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+uint16_t ESBNetworkBase<radio_t, config_t>::read(RF24NetworkHeader& header, void* message, uint16_t maxlen)
+{
+    uint16_t bufsize = 0;
+
+    // This function assumes that there is a frame in the queue.
+    // Call `available()` before calling `read()`.
+    //if (!available()) { return bufsize; }
+
+#if defined(ENABLE_FAIR_QUEUING)
+    fair_stage();
+#endif
+#if defined(RF24_LINUX)
+    const RF24NetworkFrame& frame = frame_queue.front();
+
+    // How much buffer size should we actually copy?
     bufsize = rf24_min(frame.message_size, maxlen);
     memcpy(&header, &(frame.header), sizeof(RF24NetworkHeader));
-    memcpy(message, frame.message_buffer, bufsize);
+    memcpy(message, frame_payload(frame), bufsize);
 
     IF_RF24NETWORK_DEBUG(printf_P(PSTR("%u: FRG message size %i\n"), millis(), frame.message_size););
     IF_RF24NETWORK_DEBUG(printf_P(PSTR("%u: FRG message "), millis()); const char* charPtr = reinterpret_cast<const char*>(message); for (uint16_t i = 0; i < bufsize; i++) { printf_P(PSTR("%02X "), charPtr[i]); }; printf(PSTR("\n\r")));
@@ -649,83 +2931,311 @@ uint16_t ESBNetwork<radio_t>::read(RF24NetworkHeader& header, void* message, uin
                                        "\n\r"),
                                   millis(), header.toString()));
 
+    frame_release(frame);
     frame_queue.pop();
 
 #else // !defined(RF24_LINUX)
 
-    memcpy(&header, frame_queue, 8);
-    memcpy(&bufsize, frame_queue + 8, 2);
+    #if defined(ENABLE_FAIR_QUEUING)
+    uint8_t* head = fair_head;
+    fair_head = NULL;
+    #else
+    uint8_t* head = frame_queue;
+    #endif
+    memcpy(&header, head, 8);
+    memcpy(&bufsize, head + 8, 2);
+
+    if (maxlen > 0) {
+        maxlen = rf24_min(maxlen, bufsize);
+        memcpy(message, head + 10, maxlen);
+        IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET message size %d\n"), bufsize););
+
+        IF_RF24NETWORK_DEBUG(uint16_t len = maxlen; printf_P(PSTR("NET message ")); const uint8_t* charPtr = reinterpret_cast<const uint8_t*>(message); while (len--) { printf_P(PSTR("%02x "), charPtr[len]); } printf_P(PSTR("\n\r")));
+    }
+    next_frame -= bufsize + 10;
+    uint8_t padding = 0;
+    #if !defined(ARDUINO_ARCH_AVR)
+    if ((padding = (bufsize + 10) % 4)) {
+        padding = 4 - padding;
+        next_frame -= padding;
+    }
+    #endif // !defined(ARDUINO_ARCH_AVR)
+    uint16_t consumed = bufsize + 10 + padding; // The padding of a frame at the end may exceed the frame_queue
+    uint16_t offset = head - frame_queue;         // The frames after this one are moved up
+    if (offset + consumed < sizeof(frame_queue)) {
+        memmove(head, head + consumed, sizeof(frame_queue) - offset - consumed);
+    }
+    #if defined(ENABLE_SHARED_RX_BUFFER) && !defined(DISABLE_FRAGMENTATION)
+    frag_queue.message_buffer = next_frame + 10; // The message being re-assembled was moved too
+    #endif
+    //IF_RF24NETWORK_DEBUG(printf_P(PSTR("%u: NET Received %s\n\r"), millis(), header.toString()));
+
+#endif // !defined(RF24_LINUX)
+    return bufsize;
+}
+
+#if defined RF24NetworkMulticast
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::multicast(RF24NetworkHeader& header, const void* message, uint16_t len, uint8_t level)
+{
+    // Fill out the header
+    header.to_node = NETWORK_MULTICAST_ADDRESS;
+    header.from_node = node_address;
+    return write(header, message, len, levelToAddress(level > 4 ? _multicast_level : level));
+}
+#endif
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::write(RF24NetworkHeader& header, const void* message, uint16_t len)
+{
+    return write(header, message, len, NETWORK_AUTO_ROUTING);
+}
+
+/******************************************************************/
+#if defined(ENABLE_GATHER_WRITES)
+
+// The parts of a writev() message
+struct iovecList
+{
+    const RF24NetworkIovec* iov;
+    uint8_t count;
+};
+
+/******************************************************************/
+
+static bool iovec_produce(uint8_t* buf, uint16_t offset, uint16_t len, void* context)
+{
+    const iovecList* list = (const iovecList*)context;
+    for (uint8_t i = 0; i < list->count && len; ++i) {
+        if (offset >= list->iov[i].len) {
+            offset -= list->iov[i].len;
+            continue;
+        }
+        uint16_t size = rf24_min((uint16_t)(list->iov[i].len - offset), len);
+        memcpy(buf, (const uint8_t*)list->iov[i].base + offset, size);
+        buf += size;
+        len -= size;
+        offset = 0;
+    }
+    return !len;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::writev(RF24NetworkHeader& header, const RF24NetworkIovec* iov, uint8_t iovcnt)
+{
+    uint32_t len = 0;
+    for (uint8_t i = 0; i < iovcnt; ++i) {
+        len += iov[i].len;
+    }
+    if (len > 0xFFFF) {
+        return false;
+    }
+    iovecList list = {iov, iovcnt};
+    return write(header, iovec_produce, &list, len);
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::write(RF24NetworkHeader& header, RF24NetworkProducer producer, void* context, uint16_t len)
+{
+    return write(header, NULL, len, NETWORK_AUTO_ROUTING, producer, context);
+}
+
+#endif // defined(ENABLE_GATHER_WRITES)
+/******************************************************************/
+
+// The frame size of RF24 radios is fixed
+template<class radio_t>
+static inline void update_frame_payload_size(radio_t& radio, unsigned int& max_frame_payload_size)
+{
+    (void)radio;
+    (void)max_frame_payload_size;
+}
+
+/******************************************************************/
+#if defined NRF52_RADIO_LIBRARY
+static inline void update_frame_payload_size(nrf_to_nrf& radio, unsigned int& max_frame_payload_size)
+{
+    max_frame_payload_size = (uint8_t)NRF_RADIO->PCNF1 - sizeof(RF24NetworkHeader);
+    #if defined(CCM_ENCRYPTION_ENABLED)
+    if (radio.enableEncryption == true) {
+        max_frame_payload_size -= CCM_IV_SIZE + CCM_COUNTER_SIZE + CCM_MIC_SIZE;
+    }
+    #endif
+}
+#endif
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::write(RF24NetworkHeader& header, const void* message, uint16_t len, uint16_t writeDirect)
+{
+    return write(header, message, len, writeDirect, NULL, NULL);
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::write(RF24NetworkHeader& header, const void* message, uint16_t len, uint16_t writeDirect, RF24NetworkProducer producer, void* context)
+{
+#if defined(ENABLE_ACK_PIGGYBACK)
+    // Held ACKs that are due go out before this message, even if update() isn't called for a while
+    send_held_acks();
+#endif
+    update_frame_payload_size(radio, max_frame_payload_size);
+#if defined(ENABLE_PATH_MTU)
+    // Fragment for the smallest radio on the path to the destination
+    unsigned int link_size = max_frame_payload_size;
+    uint8_t path_size = path_payload_size(header.to_node, len);
+    max_frame_payload_size = rf24_min(link_size, path_size);
+    bool ok = main_write(header, message, len, writeDirect, producer, context);
+    max_frame_payload_size = link_size;
+
+    // The path may have changed to go through a smaller radio, so fall back to the default until it is probed again
+    if (!ok && path_size > NETWORK_PATH_MTU_DEFAULT && len > NETWORK_PATH_MTU_DEFAULT) {
+        IF_RF24NETWORK_DEBUG_ROUTING(printf_P(PSTR("MAC Path MTU of 0%o forgotten\n\r"), header.to_node););
+        path_mtu_store(header.to_node, 0);
+    }
+    return ok;
+#else
+    return main_write(header, message, len, writeDirect, producer, context);
+#endif
+}
+
+/******************************************************************/
+#if defined(ENABLE_PATH_MTU)
+
+template<class radio_t, class config_t>
+uint8_t ESBNetworkBase<radio_t, config_t>::link_payload_size(void)
+{
+    unsigned int size = RF24NETWORK_MAX_FRAME_SIZE - sizeof(RF24NetworkHeader);
+    update_frame_payload_size(radio, size);
+    return size;
+}
 
-    if (maxlen > 0) {
-        maxlen = rf24_min(maxlen, bufsize);
-        memcpy(message, frame_queue + 10, maxlen);
-        IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET message size %d\n"), bufsize););
+/******************************************************************/
 
-        IF_RF24NETWORK_DEBUG(uint16_t len = maxlen; printf_P(PSTR("NET message ")); const uint8_t* charPtr = reinterpret_cast<const uint8_t*>(message); while (len--) { printf_P(PSTR("%02x "), charPtr[len]); } printf_P(PSTR("\n\r")));
-    }
-    next_frame -= bufsize + 10;
-    uint8_t padding = 0;
-    #if !defined(ARDUINO_ARCH_AVR)
-    if ((padding = (bufsize + 10) % 4)) {
-        padding = 4 - padding;
-        next_frame -= padding;
+template<class radio_t, class config_t>
+typename ESBNetworkBase<radio_t, config_t>::pathMtuEntry* ESBNetworkBase<radio_t, config_t>::path_mtu_find(uint16_t node)
+{
+    for (uint8_t i = 0; i < NETWORK_PATH_MTU_NODES; ++i) {
+        if (path_mtus[i].node == node) {
+            return &path_mtus[i];
+        }
     }
-    #endif // !defined(ARDUINO_ARCH_AVR)
-    memmove(frame_queue, frame_queue + bufsize + 10 + padding, sizeof(frame_queue) - bufsize);
-    //IF_RF24NETWORK_DEBUG(printf_P(PSTR("%u: NET Received %s\n\r"), millis(), header.toString()));
-
-#endif // !defined(RF24_LINUX)
-    return bufsize;
+    return NULL;
 }
 
-#if defined RF24NetworkMulticast
 /******************************************************************/
 
-template<class radio_t>
-bool ESBNetwork<radio_t>::multicast(RF24NetworkHeader& header, const void* message, uint16_t len, uint8_t level)
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::path_mtu_store(uint16_t node, uint8_t payload)
 {
-    // Fill out the header
-    header.to_node = NETWORK_MULTICAST_ADDRESS;
-    header.from_node = node_address;
-    return write(header, message, len, levelToAddress(level > 4 ? _multicast_level : level));
+    uint8_t slot = 0;
+    for (uint8_t i = 0; i < NETWORK_PATH_MTU_NODES; ++i) {
+        if (path_mtus[i].node == node || path_mtus[i].node == NETWORK_MULTICAST_ADDRESS) {
+            slot = i;
+            break;
+        }
+        if ((int32_t)(path_mtus[i].time - path_mtus[slot].time) < 0) {
+            slot = i;
+        }
+    }
+    path_mtus[slot].node = node;
+    path_mtus[slot].time = millis();
+    path_mtus[slot].payload = payload;
 }
-#endif
 
 /******************************************************************/
 
-template<class radio_t>
-bool ESBNetwork<radio_t>::write(RF24NetworkHeader& header, const void* message, uint16_t len)
+template<class radio_t, class config_t>
+uint8_t ESBNetworkBase<radio_t, config_t>::path_payload_size(uint16_t node, uint16_t len)
 {
-    return write(header, message, len, NETWORK_AUTO_ROUTING);
+    if (node == NETWORK_MULTICAST_ADDRESS || node == node_address) {
+        return NETWORK_PATH_MTU_DEFAULT;
+    }
+    pathMtuEntry* entry = path_mtu_find(node);
+
+    // Only messages that need more frames at the default size are worth a probe
+    if (len > NETWORK_PATH_MTU_DEFAULT && (!entry || millis() - entry->time > NETWORK_PATH_MTU_TIMEOUT)) {
+        probePathMtu(node);
+        entry = path_mtu_find(node);
+    }
+    return entry && entry->payload ? entry->payload : NETWORK_PATH_MTU_DEFAULT;
 }
 
 /******************************************************************/
 
-template<>
-bool ESBNetwork<RF24>::write(RF24NetworkHeader& header, const void* message, uint16_t len, uint16_t writeDirect)
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::probePathMtu(uint16_t node)
 {
-    return main_write(header, message, len, writeDirect);
+    if (!is_valid_address(node) || node == node_address || node == NETWORK_MULTICAST_ADDRESS) {
+        return false;
+    }
+
+    // The known payload size stays in use until the reply arrives
+    pathMtuEntry* entry = path_mtu_find(node);
+    path_mtu_store(node, entry ? entry->payload : 0);
+
+    RF24NetworkHeader header(node, NETWORK_MTU_PROBE);
+    uint8_t size = link_payload_size();
+    IF_RF24NETWORK_DEBUG_ROUTING(printf_P(PSTR("MAC Path MTU probe to 0%o\n\r"), node););
+    return write(header, &size, sizeof(size));
 }
 
 /******************************************************************/
-#if defined NRF52_RADIO_LIBRARY
-template<>
-bool ESBNetwork<nrf_to_nrf>::write(RF24NetworkHeader& header, const void* message, uint16_t len, uint16_t writeDirect)
+
+template<class radio_t, class config_t>
+uint8_t ESBNetworkBase<radio_t, config_t>::pathMtu(uint16_t node)
 {
-    max_frame_payload_size = (uint8_t)NRF_RADIO->PCNF1 - sizeof(RF24NetworkHeader);
-    #if defined(CCM_ENCRYPTION_ENABLED)
-    if (radio.enableEncryption == true) {
-        max_frame_payload_size -= CCM_IV_SIZE + CCM_COUNTER_SIZE + CCM_MIC_SIZE;
-    }
-    #endif
-    return main_write(header, message, len, writeDirect);
+    pathMtuEntry* entry = path_mtu_find(node);
+    uint8_t size = entry && entry->payload ? entry->payload : NETWORK_PATH_MTU_DEFAULT;
+    return rf24_min(size, link_payload_size());
 }
-#endif
+
+#endif // defined(ENABLE_PATH_MTU)
+
 /******************************************************************/
 
-template<class radio_t>
-bool ESBNetwork<radio_t>::main_write(RF24NetworkHeader& header, const void* message, uint16_t len, uint16_t writeDirect)
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::main_write(RF24NetworkHeader& header, const void* message, uint16_t len, uint16_t writeDirect, RF24NetworkProducer producer, void* context)
 {
+#if defined(ENABLE_FLOW_CONTROL)
+    if (header.type != NETWORK_FLOW_CONTROL && !flow_allowed(header.to_node, len)) {
+        IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET write to 0%o refused, paused by flow control\n\r"), header.to_node););
+        return false;
+    }
+#endif
+#if defined(ENABLE_GATHER_WRITES)
+    uint8_t produced[RF24NETWORK_MAX_FRAME_SIZE];
+
+    // A message that is sent in a single frame is produced up front
+    #if defined(DISABLE_FRAGMENTATION)
+    if (producer) {
+    #else
+    if (producer && (len <= max_frame_payload_size || !config_t::fragmentation)) {
+    #endif
+        if (!producer(produced, 0, rf24_min(len, max_frame_payload_size), context)) {
+            return false;
+        }
+        message = produced;
+        producer = NULL;
+    }
+#else
+    (void)producer;
+    (void)context;
+#endif
+#if defined(ENABLE_AGGREGATION)
+    if (aggregate(header, message, len, writeDirect)) {
+        return true;
+    }
+#endif
 
 #if defined(DISABLE_FRAGMENTATION)
 
@@ -734,6 +3244,11 @@ bool ESBNetwork<radio_t>::main_write(RF24NetworkHeader& header, const void* mess
 
 #else // !defined(DISABLE_FRAGMENTATION)
 
+    if (!config_t::fragmentation) {
+        frame_size = rf24_min(len + sizeof(RF24NetworkHeader), max_frame_payload_size + sizeof(RF24NetworkHeader));
+        return _write(header, message, rf24_min(len, max_frame_payload_size), writeDirect);
+    }
+
     if (len <= max_frame_payload_size) {
         //Normal Write (Un-Fragmented)
         frame_size = len + sizeof(RF24NetworkHeader);
@@ -741,15 +3256,58 @@ bool ESBNetwork<radio_t>::main_write(RF24NetworkHeader& header, const void* mess
     }
     //Check payload size
 
-    if (len > MAX_PAYLOAD_SIZE) {
-        IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET write message failed. Given 'len' %d is bigger than the MAX Payload size %i\n\r"), len, MAX_PAYLOAD_SIZE););
+    bool jumbo = false;
+    if (len > config_t::maxPayloadSize) {
+    #if defined(ENABLE_JUMBO_MESSAGES)
+        // Too long for the receivers' buffers, and possibly for an 8-bit fragment count
+        jumbo = true;
+    #else
+        IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET write message failed. Given 'len' %d is bigger than the MAX Payload size %i\n\r"), len, config_t::maxPayloadSize););
         return false;
+    #endif
+    }
+
+    // The first fragment carries first_size bytes, the rest carry more_size bytes
+    uint16_t first_size = max_frame_payload_size;
+    uint16_t more_size = max_frame_payload_size;
+    #if defined(ENABLE_COMPACT_FRAGMENTS)
+    if (!jumbo && compact_route(header.to_node, writeDirect)) {
+        more_size += NETWORK_COMPACT_SAVING;
+    }
+    #endif
+    #if defined(ENABLE_JUMBO_MESSAGES)
+    if (jumbo) {
+        first_size -= NETWORK_JUMBO_COUNT_SIZE;
+        more_size -= NETWORK_JUMBO_COUNT_SIZE;
     }
+    #endif
 
-    //Divide the message payload into chunks of max_frame_payload_size
-    uint8_t fragment_id = (len % max_frame_payload_size != 0) + ((len) / max_frame_payload_size); //the number of fragments to send = ceil(len/max_frame_payload_size)
+    //Divide the message payload into chunks
+    uint16_t fragment_id = 1 + (len - first_size + more_size - 1) / more_size; //the number of fragments to send
+
+    #if defined(ENABLE_COMPRESSION)
+    // Compress the message if that saves fragments. The first pass only measures the compressed size
+    lzssEncoder encoder;
+    uint16_t compressedLen = 0;
+    uint8_t chunk[RF24NETWORK_MAX_FRAME_SIZE];
+    uint16_t chunkLen = 0;
+    if (!jumbo && message && networkFlags & FLAG_COMPRESSION) {
+        lzss_begin(encoder, message, len);
+        uint16_t size = lzss_compress(encoder, NULL, len);
+        uint16_t fragments = 2; // A short message is split so that every fragment carries at least 1 byte
+        if (size > max_frame_payload_size) {
+            fragments = 1 + (size - max_frame_payload_size + more_size - 1) / more_size;
+        }
+        if (size >= 2 && fragments < fragment_id && fragments < NETWORK_COMPRESSED_FRAGMENTS && encoder.slack <= (int16_t)(len - size)) {
+            IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("FRG Compressed %d bytes to %d\n\r"), len, size););
+            compressedLen = size;
+            fragment_id = fragments;
+            lzss_begin(encoder, message, len);
+        }
+    }
+    #endif
 
-    uint8_t msgCount = 0;
+    uint16_t msgCount = 0;
 
     IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("FRG Total message fragments %d\n\r"), fragment_id););
 
@@ -759,6 +3317,7 @@ bool ESBNetwork<radio_t>::main_write(RF24NetworkHeader& header, const void* mess
 
     uint8_t retriesPerFrag = 0;
     uint8_t type = header.type;
+    uint16_t offset = 0;
     bool ok = 0;
 
     while (fragment_id > 0) {
@@ -768,33 +3327,77 @@ bool ESBNetwork<radio_t>::main_write(RF24NetworkHeader& header, const void* mess
         header.reserved = fragment_id;
 
         if (fragment_id == 1) {
-            header.type = NETWORK_LAST_FRAGMENT; //Set the last fragment flag to indicate the last fragment
-            header.reserved = type;              //The reserved field is used to transmit the header type
+            header.type = jumbo ? NETWORK_JUMBO_LAST_FRAGMENT : NETWORK_LAST_FRAGMENT; //Set the last fragment flag to indicate the last fragment
+            header.reserved = type;                                                     //The reserved field is used to transmit the header type
         }
         else if (msgCount == 0) {
-            header.type = NETWORK_FIRST_FRAGMENT;
+            header.type = jumbo ? NETWORK_JUMBO_FIRST_FRAGMENT : NETWORK_FIRST_FRAGMENT;
+    #if defined(ENABLE_COMPRESSION)
+            if (compressedLen) {
+                header.reserved |= NETWORK_COMPRESSED_FRAGMENTS;
+            }
+    #endif
         }
         else {
-            header.type = NETWORK_MORE_FRAGMENTS; //Set the more fragments flag to indicate a fragmented frame
+            header.type = jumbo ? NETWORK_JUMBO_MORE_FRAGMENTS : NETWORK_MORE_FRAGMENTS; //Set the more fragments flag to indicate a fragmented frame
         }
 
-        uint16_t offset = msgCount * max_frame_payload_size;
-        uint16_t fragmentLen = rf24_min((uint16_t)(len - offset), max_frame_payload_size);
+        uint16_t maxLen = msgCount ? more_size : first_size;
+        uint16_t fragmentLen = rf24_min((uint16_t)(len - offset), maxLen);
+        const char* payload = ((char*)message) + offset;
 
-        //Try to send the payload chunk with the copied header
-        frame_size = sizeof(RF24NetworkHeader) + fragmentLen;
-        ok = _write(header, ((char*)message) + offset, fragmentLen, writeDirect);
+    #if defined(ENABLE_GATHER_WRITES)
+        if (producer) {
+            // Each fragment is produced once, and kept for its retries
+            if (!retriesPerFrag && !producer(produced, offset, fragmentLen, context)) {
+                IF_RF24NETWORK_DEBUG_FRAGMENTATION(printf_P(PSTR("FRG Message aborted by the producer after %d fragments\n\r"), msgCount););
+                ok = false;
+                break;
+            }
+            payload = (const char*)produced;
+        }
+    #endif
 
-        if (!ok) {
-            uint32_t timer = millis() + 2;
-            while (millis() < timer) {
+        uint16_t payloadLen = fragmentLen;
+    #if defined(ENABLE_JUMBO_MESSAGES)
+        uint8_t jumboFrame[RF24NETWORK_MAX_FRAME_SIZE];
+        if (jumbo) {
+            // The fragment count leads the payload, since it doesn't fit in the reserved field
+            memcpy(jumboFrame, &fragment_id, NETWORK_JUMBO_COUNT_SIZE);
+            memcpy(jumboFrame + NETWORK_JUMBO_COUNT_SIZE, payload, fragmentLen);
+            payload = (const char*)jumboFrame;
+            payloadLen += NETWORK_JUMBO_COUNT_SIZE;
+        }
+    #endif
+
+    #if defined(ENABLE_COMPRESSION)
+        if (compressedLen) {
+            if (!retriesPerFrag) {
+                // Compress the next chunk, leaving at least 1 byte for each remaining fragment
+                chunkLen = lzss_compress(encoder, chunk, rf24_min((uint16_t)(compressedLen - encoder.bytes - (fragment_id - 1)), maxLen));
             }
+            frame_size = sizeof(RF24NetworkHeader) + chunkLen;
+            ok = _write(header, chunk, chunkLen, writeDirect);
+        }
+        else
+    #endif
+        {
+            //Try to send the payload chunk with the copied header
+            frame_size = sizeof(RF24NetworkHeader) + payloadLen;
+            ok = _write(header, payload, payloadLen, writeDirect);
+        }
+
+        if (!ok) {
+            // The radio stays in TX mode for the whole fragmented message (FLAG_FAST_FRAG),
+            // so there is nothing to receive while backing off
+            delay(2);
             ++retriesPerFrag;
         }
         else {
             retriesPerFrag = 0;
             fragment_id--;
             msgCount++;
+            offset += fragmentLen;
         }
 
         //if(writeDirect != NETWORK_AUTO_ROUTING){ delay(2); } //Delay 2ms between sending multicast payloads
@@ -827,11 +3430,17 @@ bool ESBNetwork<radio_t>::main_write(RF24NetworkHeader& header, const void* mess
 
 /******************************************************************/
 
-template<class radio_t>
-bool ESBNetwork<radio_t>::_write(RF24NetworkHeader& header, const void* message, uint16_t len, uint16_t writeDirect)
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::_write(RF24NetworkHeader& header, const void* message, uint16_t len, uint16_t writeDirect)
 {
     // Fill out the header
     header.from_node = node_address;
+#if defined(ENABLE_ACK_PIGGYBACK)
+    if (header.type <= MAX_USER_DEFINED_HEADER_TYPE) {
+        // Unused by user messages, but it may carry NETWORK_PIGGYBACK_ACK
+        header.reserved = 0;
+    }
+#endif
 
     // Build the full frame to send
     memcpy(frame_buffer, &header, sizeof(RF24NetworkHeader));
@@ -879,8 +3488,8 @@ bool ESBNetwork<radio_t>::_write(RF24NetworkHeader& header, const void* message,
 
 /******************************************************************/
 
-template<class radio_t>
-bool ESBNetwork<radio_t>::write(uint16_t to_node, uint8_t sendType)
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::write(uint16_t to_node, uint8_t sendType)
 {
     bool ok = false;
     bool isAckType = false;
@@ -895,6 +3504,18 @@ bool ESBNetwork<radio_t>::write(uint16_t to_node, uint8_t sendType)
     if (!is_valid_address(to_node))
         return false;
 
+#if defined(ENABLE_GATEWAY)
+    // The master hands frames for a subtree that's served by another radio over to that radio
+    if (!node_address && sendType != USER_TX_MULTICAST) {
+        ESBNetworkBase<radio_t, config_t>* gateway = gateway_routes[to_node & 0x07];
+        if (gateway && gateway != this) {
+            memcpy(gateway->frame_buffer, frame_buffer, frame_size);
+            gateway->frame_size = frame_size;
+            return gateway->write(to_node, sendType);
+        }
+    }
+#endif
+
     //Load info into our conversion structure, and get the converted address info
     logicalToPhysicalStruct conversion = {to_node, sendType, 0};
     logicalToPhysicalAddress(&conversion);
@@ -902,15 +3523,58 @@ bool ESBNetwork<radio_t>::write(uint16_t to_node, uint8_t sendType)
     IF_RF24NETWORK_DEBUG(printf_P(PSTR("MAC Sending to 0%o via 0%o on pipe %x\n\r"), to_node, conversion.send_node, conversion.send_pipe));
     /**Write it*/
     if (sendType == TX_ROUTED && conversion.send_node == to_node && isAckType) {
-        delay(2);
+#if defined(ENABLE_DEFERRED_TX)
+        // A frame fired from the timer wheel has already waited
+        if (!deferred_firing)
+#endif
+            delay(2);
+    }
+#if defined(ENABLE_ACK_PIGGYBACK)
+    // A user message to a node that waits for an ACK from this node carries the ACK along
+    uint8_t held = 0xFF;
+    if (frame_buffer[6] <= MAX_USER_DEFINED_HEADER_TYPE && !conversion.multicast) {
+        held = held_ack(((RF24NetworkHeader*)frame_buffer)->to_node);
+        if (held != 0xFF) {
+            frame_buffer[7] |= NETWORK_PIGGYBACK_ACK;
+        }
     }
+#endif
     ok = write_to_pipe(conversion.send_node, conversion.send_pipe, conversion.multicast);
 
+#if defined(ENABLE_NEIGHBOR_ROUTES)
+    // Fall back to the tree route, unless the pipe address is kept for the rest of a fragmented message
+    if (!ok && neighbor_forget(conversion.send_node) && (!(networkFlags & FLAG_FAST_FRAG) || is_first_fragment(frame_buffer[6]))) {
+        IF_RF24NETWORK_DEBUG_ROUTING(printf_P(PSTR("MAC Neighbor 0%o failed, routing to 0%o along the tree\n\r"), conversion.send_node, to_node););
+        conversion.send_node = to_node;
+        conversion.send_pipe = sendType;
+        conversion.multicast = 0;
+        logicalToPhysicalAddress(&conversion);
+        ok = write_to_pipe(conversion.send_node, conversion.send_pipe, conversion.multicast);
+    }
+#endif
+#if defined(ENABLE_ACK_PIGGYBACK)
+    if (held != 0xFF) {
+        if (ok) {
+            IF_RF24NETWORK_DEBUG_ROUTING(printf_P(PSTR("MAC ACK to 0%o sent with message %u\n\r"), held_acks[held].to_node, ((RF24NetworkHeader*)frame_buffer)->id););
+            held_acks[held].to_node = NETWORK_MULTICAST_ADDRESS;
+        }
+        else {
+            frame_buffer[7] &= ~NETWORK_PIGGYBACK_ACK;
+        }
+    }
+#endif
+
     if (!ok) {
         IF_RF24NETWORK_DEBUG_ROUTING(printf_P(PSTR("MAC Send fail to 0%o via 0%o on pipe %x\n\r"), to_node, conversion.send_node, conversion.send_pipe););
     }
 
-    if (sendType == TX_ROUTED && ok && conversion.send_node == to_node && isAckType) {
+    if (sendType == TX_ROUTED && ok && conversion.send_node == to_node && isAckType
+#if defined(ENABLE_ACK_PIGGYBACK)
+        // Unless the ACK of a user message is held back, to ride on the next message to the sender.
+        // Fragments are acknowledged right away, since the sender waits for each one
+        && (frame_buffer[6] > MAX_USER_DEFINED_HEADER_TYPE || !hold_ack(((RF24NetworkHeader*)frame_buffer)->from_node, ((RF24NetworkHeader*)frame_buffer)->id))
+#endif
+    ) {
         // NETWORK_ACK messages are only sent by the last node in the route to a target node.
         // ie: Node 00 sends to node 011, node 01 will send the network ack to 00 upon delivery.
         // Any node receiving a NETWORK_ACK message will route it as a normal message.
@@ -941,8 +3605,15 @@ bool ESBNetwork<radio_t>::write(uint16_t to_node, uint8_t sendType)
         }
         radio.startListening();
         uint32_t reply_time = millis();
+#if defined(ENABLE_ACK_PIGGYBACK)
+        uint32_t piggybacked = piggyback_acks;
+#endif
 
-        while (update() != NETWORK_ACK) {
+        while (update() != NETWORK_ACK
+#if defined(ENABLE_ACK_PIGGYBACK)
+               && piggyback_acks == piggybacked
+#endif
+        ) {
 #if defined(RF24_LINUX)
             delayMicroseconds(900);
 #endif
@@ -969,10 +3640,137 @@ bool ESBNetwork<radio_t>::write(uint16_t to_node, uint8_t sendType)
     return ok;
 }
 
+#if defined(ENABLE_DEFERRED_TX)
 /******************************************************************/
 
-template<class radio_t>
-void ESBNetwork<radio_t>::logicalToPhysicalAddress(logicalToPhysicalStruct* conversionInfo)
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::schedule_write(uint16_t to_node, uint8_t sendType, uint16_t delay_ms)
+{
+    if (!delay_ms) {
+        return false;
+    }
+    if (!deferred_count) {
+        deferred_time = millis();
+    }
+    return schedule_at(to_node, sendType, millis() + delay_ms);
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::schedule_at(uint16_t to_node, uint8_t sendType, uint32_t due)
+{
+    uint8_t slot = 0;
+    while (deferred[slot].size) {
+        if (++slot >= DEFERRED_TX_SLOTS) {
+            IF_RF24NETWORK_DEBUG_ROUTING(printf_P(PSTR("MAC Deferred TX slots full, writing to 0%o now\n"), to_node););
+            return false;
+        }
+    }
+
+    deferredFrame* entry = &deferred[slot];
+    memcpy(entry->frame, frame_buffer, frame_size);
+    entry->size = frame_size;
+    entry->to_node = to_node;
+    entry->sendType = sendType;
+    entry->due = due;
+    entry->next = DEFERRED_TX_NONE;
+
+    // Buckets that have passed but are not yet processed are counted from `deferred_time`.
+    // Frames due at the same time are written in the order they were scheduled
+    uint8_t* link = &deferred_wheel[(deferred_pos + (due - deferred_time)) % DEFERRED_TX_WHEEL_SIZE];
+    while (*link != DEFERRED_TX_NONE) {
+        link = &deferred[*link].next;
+    }
+    *link = slot;
+    ++deferred_count;
+    return true;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::defer_routed(uint16_t to_node)
+{
+    // A frame to a node that still has a routed frame waiting is queued behind it, so it isn't overtaken
+    bool waiting = false;
+    uint32_t due = 0;
+    for (uint8_t i = 0; i < DEFERRED_TX_SLOTS; ++i) {
+        if (deferred[i].size && deferred[i].sendType == TX_ROUTED && deferred[i].to_node == to_node
+            && (!waiting || (int32_t)(deferred[i].due - due) > 0)) {
+            waiting = true;
+            due = deferred[i].due;
+        }
+    }
+
+    if (!waiting) {
+        // Only an ACK-type frame on its last hop waits, for the target to start listening
+        if (frame_buffer[6] <= 64 || frame_buffer[6] >= 192) {
+            return false;
+        }
+        logicalToPhysicalStruct conversion = {to_node, TX_ROUTED, 0};
+        logicalToPhysicalAddress(&conversion);
+        return conversion.send_node == to_node && schedule_write(to_node, TX_ROUTED, 2);
+    }
+
+    if (schedule_at(to_node, TX_ROUTED, due)) {
+        return true;
+    }
+
+    // No slot is free, so wait for the frames ahead of this one to be written
+    uint8_t frame[RF24NETWORK_FRAME_BUFFER_SIZE];
+    uint8_t size = frame_size;
+    memcpy(frame, frame_buffer, size);
+    while (deferred_count && (int32_t)(due - deferred_time) > 0) {
+        write_deferred();
+    }
+    memcpy(frame_buffer, frame, size);
+    frame_size = size;
+    return false;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::write_deferred(void)
+{
+    // Don't interrupt a fragmented transmission, or a deferred frame that is already being written
+    if (deferred_firing || (networkFlags & FLAG_FAST_FRAG)) {
+        return;
+    }
+
+    uint32_t now = millis();
+    while (deferred_count && now != deferred_time) {
+        ++deferred_time;
+        deferred_pos = (deferred_pos + 1) % DEFERRED_TX_WHEEL_SIZE;
+
+        uint8_t* link = &deferred_wheel[deferred_pos];
+        while (*link != DEFERRED_TX_NONE) {
+            deferredFrame* entry = &deferred[*link];
+            // Frames due on a later turn of the wheel stay in the bucket
+            if (entry->due != deferred_time) {
+                link = &entry->next;
+                continue;
+            }
+            *link = entry->next;
+            --deferred_count;
+
+            memcpy(frame_buffer, entry->frame, entry->size);
+            frame_size = entry->size;
+            entry->size = 0;
+
+            deferred_firing = true;
+            write(entry->to_node, entry->sendType);
+            deferred_firing = false;
+        }
+    }
+}
+
+#endif // defined(ENABLE_DEFERRED_TX)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::logicalToPhysicalAddress(logicalToPhysicalStruct* conversionInfo)
 {
 
     //Create pointers so this makes sense.. kind of
@@ -1009,6 +3807,16 @@ void ESBNetwork<radio_t>::logicalToPhysicalAddress(logicalToPhysicalStruct* conv
             pre_conversion_send_node = direct_child_route_to(*to_node);
         }
     }
+#if defined(ENABLE_NEIGHBOR_ROUTES)
+    if (*directTo <= TX_ROUTED) {
+        uint16_t neighbor = neighbor_route(*to_node);
+        if (neighbor != NETWORK_MULTICAST_ADDRESS) {
+            // Talk on the neighbor's listening pipe, as its parent would
+            pre_conversion_send_node = neighbor;
+            pre_conversion_send_pipe = NUM_PIPES - 1;
+        }
+    }
+#endif
 
     *to_node = pre_conversion_send_node;
     *directTo = pre_conversion_send_pipe;
@@ -1016,19 +3824,47 @@ void ESBNetwork<radio_t>::logicalToPhysicalAddress(logicalToPhysicalStruct* conv
 
 /********************************************************/
 
-template<class radio_t>
-bool ESBNetwork<radio_t>::write_to_pipe(uint16_t node, uint8_t pipe, bool multicast)
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::write_to_pipe(uint16_t node, uint8_t pipe, bool multicast)
 {
     bool ok = false;
+    uint8_t* frame = frame_buffer;
+    uint8_t size = frame_size;
+
+    ++tx_frames;
+
+#if defined(ENABLE_TDMA)
+    if (node == parent_node && !multicast) {
+        tdma_wait();
+    }
+#endif
+
+#if defined(ENABLE_COMPACT_FRAGMENTS)
+    uint8_t compact[RF24NETWORK_MAX_FRAME_SIZE];
+    if (!multicast) {
+        if (uint8_t compactSize = compact_frame(node, compact)) {
+            frame = compact;
+            size = compactSize;
+        }
+    }
+    if (size > RF24NETWORK_MAX_FRAME_SIZE) {
+        // A continuation fragment that was received with a compact header, but can't be sent on with one
+        IF_RF24NETWORK_DEBUG_ROUTING(printf_P(PSTR("MAC Drop %d byte frame, 0%o doesn't support compact headers\n\r"), size, node););
+        return false;
+    }
+#endif
 
-    if (!(networkFlags & FLAG_FAST_FRAG) || (frame_buffer[6] == NETWORK_FIRST_FRAGMENT && networkFlags & FLAG_FAST_FRAG)) {
+    if (!(networkFlags & FLAG_FAST_FRAG) || (is_first_fragment(frame_buffer[6]) && networkFlags & FLAG_FAST_FRAG)) {
         uint8_t address[5];
         pipe_address(node, pipe, address);
         radio.stopListening(address);
         radio.setAutoAck(0, !multicast);
     }
 
-    ok = radio.writeFast(frame_buffer, frame_size, 0);
+#if defined(ENABLE_CAPTURE)
+    uint32_t start = micros();
+#endif
+    ok = radio.writeFast(frame, size, 0);
 
     if (!ok) {
         radio.txStandBy(txTimeout);
@@ -1036,9 +3872,12 @@ bool ESBNetwork<radio_t>::write_to_pipe(uint16_t node, uint8_t pipe, bool multic
             radio.setAutoAck(0, 0);
         }
     }
-    else if ((!(networkFlags & FLAG_FAST_FRAG)) || frame_buffer[6] == NETWORK_LAST_FRAGMENT) {
+    else if ((!(networkFlags & FLAG_FAST_FRAG)) || is_last_fragment(frame_buffer[6])) {
         ok = radio.txStandBy(txTimeout);
     }
+#if defined(ENABLE_CAPTURE)
+    capture(frame, size, node, pipe, RF24NETWORK_CAPTURE_TX | (ok ? RF24NETWORK_CAPTURE_OK : 0) | (multicast ? RF24NETWORK_CAPTURE_MULTICAST : 0), start);
+#endif
     /*
     #if defined (__arm__) || defined (RF24_LINUX)
     IF_RF24NETWORK_DEBUG(printf_P(PSTR("%u: MAC Sent on %x %s\n\r"), millis(), (uint32_t)out_pipe, ok ? PSTR("ok") : PSTR("failed")));
@@ -1053,7 +3892,78 @@ bool ESBNetwork<radio_t>::write_to_pipe(uint16_t node, uint8_t pipe, bool multic
 
 const char* RF24NetworkHeader::toString(void) const
 {
-    static char buffer[45];
+    static char buffer[RF24NETWORK_HEADER_STRING_SIZE];
+    return toString(buffer);
+}
+
+/******************************************************************/
+
+#if defined(RF24_LINUX)
+bool RF24NetworkPcap::open(const char* path)
+{
+    close();
+    file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    // The pcap file header, in host byte order (the magic number tells readers which one)
+    struct
+    {
+        uint32_t magic;
+        uint16_t version_major;
+        uint16_t version_minor;
+        int32_t thiszone;
+        uint32_t sigfigs;
+        uint32_t snaplen;
+        uint32_t linktype;
+    } pcapHeader = {0xa1b2c3d4, 2, 4, 0, 0, RF24NETWORK_PCAP_HEADER_SIZE + RF24NETWORK_MAX_FRAME_SIZE, RF24NETWORK_PCAP_LINKTYPE};
+    return fwrite(&pcapHeader, sizeof(pcapHeader), 1, file) == 1;
+}
+
+/******************************************************************/
+
+void RF24NetworkPcap::close(void)
+{
+    if (file) {
+        fclose(file);
+        file = NULL;
+    }
+}
+
+/******************************************************************/
+
+void RF24NetworkPcap::capture(const RF24NetworkCapture& capture, void* pcap)
+{
+    FILE* file = ((RF24NetworkPcap*)pcap)->file;
+    if (!file) {
+        return;
+    }
+    // Go back from the system clock's current time to the capture's time
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    uint64_t time = (uint64_t)now.tv_sec * 1000000 + now.tv_usec - (uint32_t)(micros() - capture.time);
+
+    uint32_t record[4] = {(uint32_t)(time / 1000000), (uint32_t)(time % 1000000), (uint32_t)RF24NETWORK_PCAP_HEADER_SIZE + capture.size, (uint32_t)RF24NETWORK_PCAP_HEADER_SIZE + capture.size};
+    uint8_t pseudoHeader[RF24NETWORK_PCAP_HEADER_SIZE] = {
+        capture.flags,
+        capture.pipe,
+        (uint8_t)capture.node,
+        (uint8_t)(capture.node >> 8),
+        (uint8_t)capture.duration,
+        (uint8_t)(capture.duration >> 8),
+        (uint8_t)(capture.duration >> 16),
+        (uint8_t)(capture.duration >> 24),
+    };
+    fwrite(record, sizeof(record), 1, file);
+    fwrite(pseudoHeader, sizeof(pseudoHeader), 1, file);
+    fwrite(capture.frame, capture.size, 1, file);
+}
+
+/******************************************************************/
+#endif
+
+const char* RF24NetworkHeader::toString(char* buffer) const
+{
     //snprintf_P(buffer,sizeof(buffer),PSTR("id %04x from 0%o to 0%o type %c"),id,from_node,to_node,type);
     sprintf_P(buffer, PSTR("id %u from 0%o to 0%o type %d"), id, from_node, to_node, type);
     return buffer;
@@ -1061,8 +3971,8 @@ const char* RF24NetworkHeader::toString(void) const
 
 /******************************************************************/
 
-template<class radio_t>
-bool ESBNetwork<radio_t>::is_direct_child(uint16_t node)
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::is_direct_child(uint16_t node)
 {
     // A direct child of ours has the same low numbers as us, and only
     // one higher number.
@@ -1077,16 +3987,35 @@ bool ESBNetwork<radio_t>::is_direct_child(uint16_t node)
 
 /******************************************************************/
 
-template<class radio_t>
-bool ESBNetwork<radio_t>::is_descendant(uint16_t node)
+template<class radio_t, class config_t>
+uint8_t ESBNetworkBase<radio_t, config_t>::child_pipe(uint16_t node)
+{
+    if (node == node_address || !is_descendant(node)) {
+        return 0;
+    }
+    // The child's pipe is the digit after this node's address
+    uint16_t child = direct_child_route_to(node);
+    uint16_t m = node_mask;
+    while (m) {
+        child >>= 3;
+        m >>= 3;
+    }
+    uint8_t pipe = child & 0x07;
+    return pipe < NUM_PIPES ? pipe : 0;
+}
+
+/******************************************************************/
+
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::is_descendant(uint16_t node)
 {
     return (node & node_mask) == node_address;
 }
 
 /******************************************************************/
 
-template<class radio_t>
-void ESBNetwork<radio_t>::setup_address(void)
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::setup_address(void)
 {
     // First, establish the node_mask
     uint16_t node_mask_check = 0xFFFF;
@@ -1130,8 +4059,8 @@ void ESBNetwork<radio_t>::setup_address(void)
 
 /******************************************************************/
 
-template<class radio_t>
-uint16_t ESBNetwork<radio_t>::addressOfPipe(uint16_t node, uint8_t pipeNo)
+template<class radio_t, class config_t>
+uint16_t ESBNetworkBase<radio_t, config_t>::addressOfPipe(uint16_t node, uint8_t pipeNo)
 {
     //Say this node is 013 (1011), mask is 077 or (00111111)
     //Say we want to use pipe 3 (11)
@@ -1148,8 +4077,8 @@ uint16_t ESBNetwork<radio_t>::addressOfPipe(uint16_t node, uint8_t pipeNo)
 
 /******************************************************************/
 
-template<class radio_t>
-uint16_t ESBNetwork<radio_t>::direct_child_route_to(uint16_t node)
+template<class radio_t, class config_t>
+uint16_t ESBNetworkBase<radio_t, config_t>::direct_child_route_to(uint16_t node)
 {
     // Presumes that this is in fact a child!!
     uint16_t child_mask = (node_mask << 3) | 0x07;
@@ -1158,8 +4087,8 @@ uint16_t ESBNetwork<radio_t>::direct_child_route_to(uint16_t node)
 
 /******************************************************************/
 
-template<class radio_t>
-bool ESBNetwork<radio_t>::is_valid_address(uint16_t node)
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::is_valid_address(uint16_t node)
 {
     bool result = true;
     if (node == NETWORK_MULTICAST_ADDRESS || node == NETWORK_MULTICAST_ADDRESS_LEVEL_2 || node == NETWORK_MULTICAST_ADDRESS_LEVEL_4) {
@@ -1190,8 +4119,8 @@ bool ESBNetwork<radio_t>::is_valid_address(uint16_t node)
 #if defined(RF24NetworkMulticast)
 /******************************************************************/
 
-template<class radio_t>
-void ESBNetwork<radio_t>::multicastLevel(uint8_t level)
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::multicastLevel(uint8_t level)
 {
     _multicast_level = level;
     radio.stopListening();
@@ -1203,8 +4132,8 @@ void ESBNetwork<radio_t>::multicastLevel(uint8_t level)
 
 /******************************************************************/
 
-template<class radio_t>
-uint16_t ESBNetwork<radio_t>::levelToAddress(uint8_t level)
+template<class radio_t, class config_t>
+uint16_t ESBNetworkBase<radio_t, config_t>::levelToAddress(uint8_t level)
 {
 
     uint16_t levelAddr = 1;
@@ -1216,11 +4145,49 @@ uint16_t ESBNetwork<radio_t>::levelToAddress(uint8_t level)
     return levelAddr;
 }
 
-#endif // !defined(RF24NetworkMulticast)
+
+    #if defined(ENABLE_MULTICAST_DEDUP)
 /******************************************************************/
 
-template<class radio_t>
-void ESBNetwork<radio_t>::pipe_address(uint16_t node, uint8_t pipe, uint8_t* address)
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::is_multicast_duplicate(RF24NetworkHeader* header)
+{
+    // CRC-16/CCITT from the header's id on (id, type, reserved and the payload), so frames that
+    // reuse a header with another payload aren't taken for duplicates, even with the same bytes reordered
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 4; i < frame_size; ++i) {
+        crc ^= (uint16_t)frame_buffer[i] << 8;
+        for (uint8_t bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    uint16_t now = millis();
+
+    for (uint8_t i = 0; i < MULTICAST_DEDUP_SIZE; ++i) {
+        multicastDedupEntry* entry = &multicast_dedup[i];
+        if (entry->from_node == header->from_node && entry->id == header->id && entry->type == header->type && entry->reserved == header->reserved && entry->crc == crc && (uint16_t)(now - entry->time) < MULTICAST_DEDUP_TIMEOUT) {
+            ++multicast_duplicates;
+            return true;
+        }
+    }
+
+    multicastDedupEntry* entry = &multicast_dedup[multicast_dedup_next];
+    entry->from_node = header->from_node;
+    entry->id = header->id;
+    entry->time = now;
+    entry->type = header->type;
+    entry->reserved = header->reserved;
+    entry->crc = crc;
+    multicast_dedup_next = (multicast_dedup_next + 1) % MULTICAST_DEDUP_SIZE;
+    return false;
+}
+
+    #endif // defined(ENABLE_MULTICAST_DEDUP)
+#endif     // !defined(RF24NetworkMulticast)
+/******************************************************************/
+
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::pipe_address(uint16_t node, uint8_t pipe, uint8_t* address)
 {
 
     static uint8_t address_translation[] = { 0xc3,
@@ -1283,8 +4250,8 @@ ISR(WDT_vect)
     --sleep_cycles_remaining;
 }
 
-template<class radio_t>
-bool ESBNetwork<radio_t>::sleepNode(unsigned int cycles, int interruptPin, uint8_t INTERRUPT_MODE)
+template<class radio_t, class config_t>
+bool ESBNetworkBase<radio_t, config_t>::sleepNode(unsigned int cycles, int interruptPin, uint8_t INTERRUPT_MODE)
 {
     sleep_cycles_remaining = cycles;
     set_sleep_mode(SLEEP_MODE_PWR_DOWN); // sleep mode is set here
@@ -1319,8 +4286,8 @@ bool ESBNetwork<radio_t>::sleepNode(unsigned int cycles, int interruptPin, uint8
     return !wasInterrupted;
 }
 
-template<class radio_t>
-void ESBNetwork<radio_t>::setup_watchdog(uint8_t prescalar)
+template<class radio_t, class config_t>
+void ESBNetworkBase<radio_t, config_t>::setup_watchdog(uint8_t prescalar)
 {
 
     uint8_t wdtcsr = prescalar & 7;
@@ -1341,7 +4308,19 @@ void ESBNetwork<radio_t>::setup_watchdog(uint8_t prescalar)
 #endif     // Enable sleep mode
 
 // ensure the compiler is aware of the possible datatype for the template class
+template class ESBNetworkBase<RF24, RF24NetworkConfig>;
 template class ESBNetwork<RF24>;
+#if defined(RF24NETWORK_EXTRA_CONFIG)
+template class ESBNetworkBase<RF24, RF24NETWORK_EXTRA_CONFIG>;
+#endif
+#if defined(ENABLE_REPLAY) && defined(RF24_LINUX)
+template class ESBNetworkBase<RF24NetworkReplay, RF24NetworkConfig>;
+template class ESBNetwork<RF24NetworkReplay>;
+#endif
 #if defined(ARDUINO_ARCH_NRF52) || defined(ARDUINO_ARCH_NRF52840) || defined(ARDUINO_ARCH_NRF52833) || defined(ARDUINO_NRF54L15)
+template class ESBNetworkBase<nrf_to_nrf, RF24NetworkConfig>;
 template class ESBNetwork<nrf_to_nrf>;
+    #if defined(RF24NETWORK_EXTRA_CONFIG)
+template class ESBNetworkBase<nrf_to_nrf, RF24NETWORK_EXTRA_CONFIG>;
+    #endif
 #endif
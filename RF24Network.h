@@ -30,6 +30,9 @@
     #include <map>
     #include <utility> // std::pair
     #include <queue>
+    #if defined(ENABLE_JUMBO_MESSAGES)
+        #include <vector>
+    #endif
 
 //ATXMega
 #elif defined(XMEGA_D3)
@@ -119,6 +122,45 @@
 #define NETWORK_LAST_FRAGMENT 150
 //#define NETWORK_LAST_FRAGMENT 201
 
+/**
+ * This bit is set in the fragment count (the `reserved` field) of a @ref NETWORK_FIRST_FRAGMENT
+ * when the message's payload was compressed (see @ref FLAG_COMPRESSION). It is decompressed once
+ * re-assembled. Nodes without `ENABLE_COMPRESSION` drop these messages, since the fragment count
+ * doesn't match the following fragments.
+ *
+ * Since this bit is part of the fragment count, `ENABLE_COMPRESSION` limits `MAX_PAYLOAD_SIZE` to
+ * @ref NETWORK_COMPRESSION_MAX_SIZE, so that uncompressed messages never have 128 or more fragments.
+ */
+#define NETWORK_COMPRESSED_FRAGMENTS 0x80
+
+/**
+ * Messages of this type designate the first fragment of a jumbo message: a message larger than the
+ * sender's `MAX_PAYLOAD_SIZE`, sent by nodes with `ENABLE_JUMBO_MESSAGES`. Jumbo fragments carry
+ * a 16-bit fragment count (see @ref NETWORK_JUMBO_COUNT_SIZE), so a message can have up to 65535
+ * bytes. They are re-assembled by Linux nodes with `ENABLE_JUMBO_MESSAGES`, and routed like
+ * other fragments by all nodes.
+ */
+#define NETWORK_JUMBO_FIRST_FRAGMENT 153
+
+/**
+ * Messages of this type indicate a jumbo message fragment that is neither the first nor the last.
+ * @see NETWORK_JUMBO_FIRST_FRAGMENT
+ */
+#define NETWORK_JUMBO_MORE_FRAGMENTS 154
+
+/**
+ * Messages of this type indicate the last fragment of a jumbo message. Like for
+ * @ref NETWORK_LAST_FRAGMENT, the `reserved` field holds the message's header type.
+ * @see NETWORK_JUMBO_FIRST_FRAGMENT
+ */
+#define NETWORK_JUMBO_LAST_FRAGMENT 155
+
+/**
+ * The size of the fragment count at the start of each jumbo fragment's payload. It holds the
+ * number of fragments left (including this one), in place of the `reserved` field of other fragments.
+ */
+#define NETWORK_JUMBO_COUNT_SIZE 2
+
 // NO ACK Response Types
 //#define NETWORK_ACK_REQUEST 192
 
@@ -170,6 +212,15 @@
  */
 #define NETWORK_ACK 193
 
+/**
+ * This bit is set in the `reserved` field of a user message (types 0 - 127) by a node with
+ * `ENABLE_ACK_PIGGYBACK`, when the message also stands for a held back @ref NETWORK_ACK to its
+ * destination. The destination clears it and handles the message as usual: update() returns the
+ * message's type, and the write() waiting for the ACK completes. The ACKs received this way are
+ * counted by ESBNetwork::piggybackedAcks().
+ */
+#define NETWORK_PIGGYBACK_ACK 0x80
+
 /**
  * Used by RF24Mesh
  *
@@ -190,6 +241,96 @@
 // The following 2 atrifacts now exist in RF24Mesh as their significance was specific to RF24Mesh.
 //#define NETWORK_ADDR_LOOKUP 196
 //#define NETWORK_ADDR_RELEASE 197
+
+/**
+ * Used by RF24NetworkStream
+ *
+ * Messages of this type carry a numbered segment of a stream transfer. They are read and processed
+ * by ESBNetworkStream::update().
+ */
+#define NETWORK_STREAM_DATA 201
+
+/**
+ * Used by RF24NetworkStream
+ *
+ * Messages of this type are sent by the receiver of a stream transfer to acknowledge
+ * @ref NETWORK_STREAM_DATA segments (cumulatively and selectively).
+ */
+#define NETWORK_STREAM_ACK 202
+
+/**
+ * Messages of this type are sent by a node with `ENABLE_FLOW_CONTROL` when its incoming frame
+ * buffer is nearly full. The payload holds the pause duration in milliseconds and the number of
+ * bytes still free in the receiver's buffer (2 bytes each). A pause of 0 resumes the sender.
+ *
+ * These messages are processed internally by update(), and the paused node's
+ * write(RF24NetworkHeader&, const void*, uint16_t) returns false for the pausing node until the
+ * pause expires or is lifted.
+ */
+#define NETWORK_FLOW_CONTROL 203
+
+/**
+ * Messages of this type are sent by a node with `ENABLE_COMPACT_FRAGMENTS` to its parent when
+ * begin() is called, and answered by the parent, so both nodes know that continuation fragments
+ * (@ref NETWORK_MORE_FRAGMENTS and @ref NETWORK_LAST_FRAGMENT) can be sent to each other with a
+ * compact header. The 1 byte payload is 1 to request an answer.
+ *
+ * These messages are processed internally by update().
+ */
+#define NETWORK_COMPACT_HELLO 204
+
+/**
+ * Messages of this type are sent by a node with `ENABLE_AGGREGATION` to a neighbor (its parent
+ * or a direct child), and carry several small messages that are routed through that neighbor.
+ * The payload is a sequence of sub-messages, each with a @ref NETWORK_AGGREGATE_SUBHEADER_SIZE
+ * byte sub-header (the `to_node`, `type` and payload length) followed by its payload. The
+ * `reserved` byte holds the number of sub-messages. Their `from_node` is the aggregate's, and
+ * their IDs count up from the aggregate's `id`.
+ *
+ * These messages are unpacked internally by update(), which then handles each sub-message as if
+ * it was received by itself.
+ */
+#define NETWORK_AGGREGATE 205
+
+/**
+ * Messages of this type are sent by a node with `ENABLE_NEIGHBOR_ROUTES` directly to another node
+ * (without routing) to find out if it is in radio range. The receiver adds the sender to its
+ * neighbors as well.
+ *
+ * These messages are processed internally by update().
+ * @see ESBNetwork::probeNeighbor()
+ */
+#define NETWORK_NEIGHBOR_PROBE 206
+
+/**
+ * Messages of this type are multicast by a node with `ENABLE_TDMA` (and a non-zero
+ * `tdmaSlotTime`) to the multicast level of its children, at the start of each TDMA frame. The
+ * payload is the slot length in milliseconds, followed by one byte per slot: the pipe number
+ * (1 - 5) of the child that may send in the slot, or 0 for a contention slot. The beacon itself
+ * occupies the first slot of the frame.
+ *
+ * These messages are processed internally by update(), and only by the sender's children.
+ */
+#define NETWORK_TDMA_BEACON 207
+
+/**
+ * Messages of this type are sent by a node with `ENABLE_PATH_MTU` to find out the largest frame
+ * payload that every radio on the path to the destination carries. The 1 byte payload starts as
+ * the sender's own payload size, and is lowered to its own by each node that routes or receives it.
+ * The destination answers with a @ref NETWORK_MTU_REPLY.
+ *
+ * These messages are processed internally by update().
+ * @see ESBNetwork::probePathMtu()
+ */
+#define NETWORK_MTU_PROBE 208
+
+/**
+ * Messages of this type answer a @ref NETWORK_MTU_PROBE. The 1 byte payload is the probe's
+ * payload size as it arrived at the destination.
+ *
+ * These messages are processed internally by update().
+ */
+#define NETWORK_MTU_REPLY 209
 /** @} */
 
 /* This isn't actually used anywhere. */
@@ -210,6 +351,25 @@
 
 #define FRAME_HEADER_SIZE 10 // Size of RF24Network frames - data
 
+/**
+ * The size of the header of continuation fragments sent between nodes with `ENABLE_COMPACT_FRAGMENTS`:
+ * the low byte of the message ID, a byte with the compact frame marker (0xF0), the last fragment
+ * flag (0x08) and the sending neighbor's pipe (0 for the parent), and the `reserved` byte.
+ */
+#define NETWORK_COMPACT_HEADER_SIZE 3
+/** The payload bytes gained by continuation fragments with a compact header */
+#define NETWORK_COMPACT_SAVING (8 - NETWORK_COMPACT_HEADER_SIZE)
+
+/** The size of the sub-header of each message carried by a @ref NETWORK_AGGREGATE frame */
+#define NETWORK_AGGREGATE_SUBHEADER_SIZE 4
+
+#if defined(ENABLE_COMPACT_FRAGMENTS)
+    // Continuation fragments received with a compact header are expanded in the frame_buffer
+    #define RF24NETWORK_FRAME_BUFFER_SIZE (RF24NETWORK_MAX_FRAME_SIZE + NETWORK_COMPACT_SAVING)
+#else
+    #define RF24NETWORK_FRAME_BUFFER_SIZE RF24NETWORK_MAX_FRAME_SIZE
+#endif
+
 /**
  * A sentinel value signifying that the current radio channel should be unchanged when setting
  * up the network node with RF24Network::begin(uint8_t _channel, uint16_t _node_address).
@@ -227,6 +387,43 @@
  * accordingly.
  */
 #define FLAG_NO_POLL 8
+/**
+ * This flag (when asserted in RF24Network::networkFlags) drops received user messages (types
+ * 0 - 127) that have no handler registered with RF24Network::setHandler(), instead of loading
+ * them into the user cache. Requires `ENABLE_TYPE_HANDLERS`.
+ */
+#define FLAG_DROP_UNHANDLED 16
+/**
+ * This flag (when asserted in RF24Network::networkFlags) compresses the payload of fragmented
+ * messages, when that reduces the number of fragments. Requires `ENABLE_COMPRESSION` on this node
+ * and the receiving node.
+ * @see NETWORK_COMPRESSED_FRAGMENTS
+ */
+#define FLAG_COMPRESSION 32
+/**
+ * This flag (when asserted in RF24Network::networkFlags) declares that all nodes on the routes of
+ * this node's messages have `ENABLE_COMPACT_FRAGMENTS`. Continuation fragments then carry
+ * @ref NETWORK_COMPACT_SAVING more bytes of payload whenever the first hop supports compact headers,
+ * instead of only when the first hop is the destination. Requires `ENABLE_COMPACT_FRAGMENTS`.
+ */
+#define FLAG_COMPACT_ROUTES 64
+
+/**
+ * **Linux platforms only**
+ *
+ * A drop policy for RF24Network::setDropPolicy() and RF24Network::dropPolicy. When a queue is
+ * full, the newly received frame is dropped. This is how the fixed-size buffer of other platforms
+ * behaves.
+ */
+#define NETWORK_DROP_NEWEST 0
+/**
+ * **Linux platforms only**
+ *
+ * A drop policy for RF24Network::setDropPolicy() and RF24Network::dropPolicy. When a queue is
+ * full, the oldest frame in the queue is dropped to make room for the newly received frame, so
+ * the freshest data (ie: telemetry) wins.
+ */
+#define NETWORK_DROP_OLDEST 1
 
 class RF24;
 #if defined(ARDUINO_ARCH_NRF52) || defined(ARDUINO_ARCH_NRF52840) || defined(ARDUINO_ARCH_NRF52833) || defined(ARDUINO_NRF54L15)
@@ -311,8 +508,22 @@ struct RF24NetworkHeader
      * @return String representation of the object's significant members.
      */
     const char* toString(void) const;
+
+    /**
+     * Create debugging string in the caller's memory
+     *
+     * The same as toString(void), but safe to use from several network instances or threads.
+     *
+     * @param buffer The memory to write the string to. It must hold at least
+     * @ref RF24NETWORK_HEADER_STRING_SIZE bytes.
+     * @return @p buffer
+     */
+    const char* toString(char* buffer) const;
 };
 
+/** The size of the buffer needed by RF24NetworkHeader::toString(char*) */
+#define RF24NETWORK_HEADER_STRING_SIZE 45
+
 /**
  * Frame structure for internal message handling, and for use by external applications
  *
@@ -383,19 +594,247 @@ struct RF24NetworkFrame
 #endif
 };
 
+/**
+ * The signature of the functions registered with RF24Network::setHandler()
+ *
+ * @param header The received message's header
+ * @param message The received message. This is only valid until the handler returns, and for messages
+ * that fit in a single frame it is overwritten by any write() (so copy what is needed first).
+ * @param len The size of @p message in bytes
+ * @param context The pointer that was passed to RF24Network::setHandler()
+ */
+typedef void (*RF24NetworkHandler)(RF24NetworkHeader& header, const uint8_t* message, uint16_t len, void* context);
+
+/**
+ * A buffer that holds part of a message written with RF24Network::writev()
+ */
+struct RF24NetworkIovec
+{
+    /** The first byte of this part */
+    const void* base;
+    /** The size of this part in bytes */
+    uint16_t len;
+};
+
+/**
+ * The signature of the functions that produce a message written with RF24Network::write(RF24NetworkHeader&, RF24NetworkProducer, void*, uint16_t)
+ *
+ * The function is called once for each frame of the message, in order, with the bytes of the
+ * message that the frame carries. Frames that need to be sent again reuse the produced bytes.
+ *
+ * @param[out] buf Where the bytes should be placed
+ * @param offset The position of the first byte in the message
+ * @param len The number of bytes to produce
+ * @param context The pointer that was passed to RF24Network::write()
+ * @return False to abort the message. The frames that were sent are discarded by the receiver.
+ */
+typedef bool (*RF24NetworkProducer)(uint8_t* buf, uint16_t offset, uint16_t len, void* context);
+
+/**
+ * @defgroup FRAGMENT_EVENTS Fragment stream events
+ *
+ * The events passed to an RF24NetworkFragmentHandler
+ * @{
+ */
+/**
+ * The first fragment of a message arrived. The header is the first fragment's: its `reserved`
+ * field holds the number of fragments, and the message's type isn't known yet. Return false to
+ * re-assemble the message as usual instead.
+ */
+#define RF24NETWORK_FRAGMENT_START 0
+/** The next fragment's payload, in order. Return false to abort the message */
+#define RF24NETWORK_FRAGMENT_CHUNK 1
+/** The last fragment was handed over. The header has the message's type, and the length is the message size */
+#define RF24NETWORK_FRAGMENT_END 2
+/**
+ * The message won't complete: a fragment was lost, the sender started another message or stalled
+ * for FRAGMENT_STREAM_TIMEOUT milliseconds, or the handler aborted it
+ */
+#define RF24NETWORK_FRAGMENT_ABORT 3
+/** @} */
+
+/**
+ * The signature of the function registered with RF24Network::setFragmentHandler()
+ *
+ * @param event See @ref FRAGMENT_EVENTS
+ * @param header The header of the fragment (or message) that the event is about
+ * @param data The fragment's payload for @ref RF24NETWORK_FRAGMENT_CHUNK, otherwise NULL. It is only
+ * valid until the function returns.
+ * @param len The size of @p data, the message size for @ref RF24NETWORK_FRAGMENT_END, or the bytes handed
+ * over so far for @ref RF24NETWORK_FRAGMENT_ABORT
+ * @param context The pointer that was passed to RF24Network::setFragmentHandler()
+ * @return See @ref FRAGMENT_EVENTS. Ignored for the end and abort events.
+ */
+typedef bool (*RF24NetworkFragmentHandler)(uint8_t event, const RF24NetworkHeader& header, const uint8_t* data, uint16_t len, void* context);
+
+/**
+ * @defgroup CAPTURE_FLAGS Capture flags
+ *
+ * Bits of RF24NetworkCapture::flags
+ * @{
+ */
+/** The frame was sent by this node (otherwise it was received) */
+#define RF24NETWORK_CAPTURE_TX 0x01
+/** The frame was received, or sent and acknowledged by the next hop's radio */
+#define RF24NETWORK_CAPTURE_OK 0x02
+/** The frame was sent to (or received on) a multicast address */
+#define RF24NETWORK_CAPTURE_MULTICAST 0x04
+/** @} */
+
+/**
+ * A radio frame recorded by the capture hook (see RF24Network::setCapture())
+ */
+struct RF24NetworkCapture
+{
+    /** micros() when the frame was received, or when its transmission started */
+    uint32_t time;
+    /** The microseconds that the transmission took, including the radio's auto-retries. 0 for received frames */
+    uint32_t duration;
+    /** The frame's bytes as they went over the air. A compact header (see `ENABLE_COMPACT_FRAGMENTS`) isn't expanded */
+    const uint8_t* frame;
+    /** The logical address of the next hop for sent frames, or this node for received frames */
+    uint16_t node;
+    /** The size of @ref frame */
+    uint8_t size;
+    /** The pipe that the frame was received on, or the pipe of the next hop that it was sent to */
+    uint8_t pipe;
+    /** See @ref CAPTURE_FLAGS */
+    uint8_t flags;
+};
+
+/**
+ * The signature of the functions registered with RF24Network::setCapture()
+ *
+ * @param capture The recorded frame. Its `frame` is only valid until the function returns.
+ * @param context The pointer that was passed to RF24Network::setCapture()
+ */
+typedef void (*RF24NetworkCaptureHandler)(const RF24NetworkCapture& capture, void* context);
+
+#if defined(RF24_LINUX) || defined(DOXYGEN_FORCED)
+/** The pcap link type of files written by RF24NetworkPcap (LINKTYPE_USER0) */
+    #define RF24NETWORK_PCAP_LINKTYPE 147
+/** The size of the pseudo-header that precedes each frame in files written by RF24NetworkPcap */
+    #define RF24NETWORK_PCAP_HEADER_SIZE 8
+
+/**
+ * Write captured frames to a pcap file (Linux only)
+ *
+ * Each packet of the file (with link type @ref RF24NETWORK_PCAP_LINKTYPE) is a pseudo-header,
+ * followed by the frame as it went over the air. The pseudo-header holds the fields of
+ * RF24NetworkCapture in little endian byte order: `flags` (1 byte), `pipe` (1 byte), `node`
+ * (2 bytes) and `duration` (4 bytes). Packets are time-stamped with the system clock.
+ *
+ * Load `extras/wireshark/rf24network.lua` into Wireshark to dissect the files, including the
+ * RF24NetworkHeader, fragments and compact headers.
+ *
+ * @code
+ * RF24NetworkPcap pcap;
+ * pcap.open("network.pcap");
+ * network.setCapture(RF24NetworkPcap::capture, &pcap);
+ * @endcode
+ */
+class RF24NetworkPcap
+{
+public:
+    RF24NetworkPcap(void) : file(NULL) {}
+    ~RF24NetworkPcap(void) { close(); }
+
+    /**
+     * Create a pcap file (replacing an existing file) and write the file header
+     * @return False if the file can't be created
+     */
+    bool open(const char* path);
+
+    /** Flush and close the file */
+    void close(void);
+
+    /**
+     * The function to register with RF24Network::setCapture()
+     *
+     * @param capture The recorded frame
+     * @param pcap The RF24NetworkPcap instance (must be open) to write to
+     */
+    static void capture(const RF24NetworkCapture& capture, void* pcap);
+
+private:
+    FILE* file;
+};
+#endif
+
+/**
+ * A configuration policy for ESBNetworkBase, which sets the buffer sizes and features of a
+ * network instance at compile time. Besides the default @ref RF24NetworkConfig, one alternate
+ * policy can be used by a program.
+ *
+ * @code
+ * // RF24Network_config.h: a relay-only instance, which needs no fragmentation cache
+ * #define RF24NETWORK_EXTRA_CONFIG RF24NetworkPolicy<32, false>
+ *
+ * // The sketch: an MCU with a second radio, beside the default instance
+ * RF24Network network(radio);
+ * ESBNetworkBase<RF24, RF24NETWORK_EXTRA_CONFIG> relayNetwork(radio2);
+ * @endcode
+ * @note Instances are compiled in RF24Network.cpp, so the alternate policy must be named by
+ * `RF24NETWORK_EXTRA_CONFIG` in RF24Network_config.h.
+ * @note Only the settings of the policy differ between instances. `NUM_PIPES`,
+ * `RF24NetworkMulticast` and the `ENABLE_*` options of RF24Network_config.h still apply to all of
+ * them, and ESBNetworkStream, ESBNetworkGateway and RF24Mesh only work with ESBNetwork (the
+ * default policy).
+ * @note The memory savings apply to MCUs. On Linux, `_maxPayloadSize` only limits the size of the
+ * messages sent and re-assembled: every RF24NetworkFrame still holds a `MAX_PAYLOAD_SIZE` buffer.
+ *
+ * @tparam _maxPayloadSize The largest message that can be sent or received (re-assembled). This sizes the
+ * incoming frame buffer and the fragmentation cache on MCUs. On Linux it can't exceed @ref MAX_PAYLOAD_SIZE.
+ * @tparam _fragmentation Set to false to send only the first frame of larger messages and not re-assemble
+ * incoming fragments (like `DISABLE_FRAGMENTATION`, but for one instance).
+ * @tparam _userPayloads Set to false to not cache user messages at all (like `DISABLE_USER_PAYLOADS`,
+ * but for one instance).
+ */
+template<uint16_t _maxPayloadSize, bool _fragmentation = true, bool _userPayloads = true>
+struct RF24NetworkPolicy
+{
+    /** The largest message that can be sent or received */
+    static const uint16_t maxPayloadSize = _maxPayloadSize;
+    /** Whether messages larger than a frame are fragmented and re-assembled */
+    static const bool fragmentation = _fragmentation;
+    /** Whether user messages are cached for read() */
+    static const bool userPayloads = _userPayloads;
+};
+
+/**
+ * The default configuration policy, taken from `MAX_PAYLOAD_SIZE`, `DISABLE_FRAGMENTATION` and
+ * `DISABLE_USER_PAYLOADS` in RF24Network_config.h. This is the configuration of ESBNetwork.
+ */
+typedef RF24NetworkPolicy<MAX_PAYLOAD_SIZE,
+#if defined(DISABLE_FRAGMENTATION)
+                          false,
+#else
+                          true,
+#endif
+#if defined(DISABLE_USER_PAYLOADS)
+                          false>
+#else
+                          true>
+#endif
+    RF24NetworkConfig;
+
 /**
  * 2014-2021 - Optimized Network Layer for RF24 Radios
  *
  * This class implements an OSI Network Layer using nRF24L01(+) radios driven
  * by RF24 library.
  *
+ * Most applications use ESBNetwork (or the RF24Network typedef), which is this class with the
+ * configuration from RF24Network_config.h.
+ *
  * @tparam radio_t The `radio` object's type. Defaults to `RF24` for legacy behavior.
  * This new abstraction is really meant for using the nRF52840 SoC as a drop-in replacement
  * for the nRF24L01 radio. For more detail, see the
  * [nrf_to_nrf Arduino library](https://github.com/TMRh20/nrf_to_nrf).
+ * @tparam config_t The configuration policy, see RF24NetworkPolicy. Defaults to @ref RF24NetworkConfig.
  */
-template<class radio_t = RF24>
-class ESBNetwork
+template<class radio_t = RF24, class config_t = RF24NetworkConfig>
+class ESBNetworkBase
 {
 
     /**
@@ -423,7 +862,7 @@ public:
      *
      * @param _radio The underlying radio driver instance
      */
-    ESBNetwork(radio_t& _radio);
+    ESBNetworkBase(radio_t& _radio);
 
     /**
      * Bring up the network using the current radio frequency/channel.
@@ -456,10 +895,50 @@ public:
      * This function must be called regularly to keep the layer going.  This is where payloads are
      * re-routed, received, and all the action happens.
      *
-     * @return Returns the @ref RF24NetworkHeader::type of the last received payload.
+     * @return Returns the @ref RF24NetworkHeader::type of the last received payload, or
+     * @ref NETWORK_OVERRUN if frames were processed for 100 milliseconds and more are waiting.
+     * @see update(uint8_t, uint32_t) to limit the frames processed by one call
      */
     uint8_t update(void);
 
+    /**
+     * Main layer loop, with a budget for the frames processed by one call
+     *
+     * update(void) processes all waiting frames (for up to 100 milliseconds), which delays the rest
+     * of the main loop under heavy traffic. This stops once the budget is used up, and leaves the
+     * remaining frames in the radio's RX FIFO for the next call, so radio servicing can be
+     * interleaved with time critical work.
+     *
+     * @code
+     * while (true) {
+     *     network.update(4, 2000); // at most 4 frames or 2 milliseconds
+     *     refreshDisplay();
+     * }
+     * @endcode
+     *
+     * The work done before any frame is received (deferred, aggregated and held frames, and TDMA
+     * beacons, when enabled) is charged to the same budget: every frame sent for it counts as a
+     * processed frame, and its time counts against @p maxMicros.
+     *
+     * @param maxFrames The most frames to process, or 0 for no limit
+     * @param maxMicros The time (in microseconds) after which no further frame is processed, or 0
+     * for no limit. At least one received frame is processed, and a frame that is already being
+     * processed is finished, which can take up to `txTimeout` for a frame that's routed on.
+     * @return The same as update(void) (including @ref NETWORK_OVERRUN when frames were processed
+     * for 100 milliseconds). Use budgetExhausted() to test whether frames were left for the next call.
+     */
+    uint8_t update(uint8_t maxFrames, uint32_t maxMicros = 0);
+
+    /**
+     * Test whether the last call to update(uint8_t, uint32_t) used up its budget
+     *
+     * @return Whether frames were left in the radio's RX FIFO for the next call
+     */
+    bool budgetExhausted(void) const
+    {
+        return budget_exhausted;
+    }
+
     /**
      * Test whether there is a message available for this node
      *
@@ -492,7 +971,7 @@ public:
      * If this parameter is left unspecified, the entire length of the message is fetched.
      * Hint: Use peek(RF24NetworkHeader) to get the length of next available message in the queue.
      */
-    void peek(RF24NetworkHeader& header, void* message, uint16_t maxlen = MAX_PAYLOAD_SIZE);
+    void peek(RF24NetworkHeader& header, void* message, uint16_t maxlen = config_t::maxPayloadSize);
 
     /**
      * Read a message
@@ -516,13 +995,19 @@ public:
      * Hint: Use peek(RF24NetworkHeader &) to get the length of next available message in the queue.
      * @return The total number of bytes copied into @p message
      */
-    uint16_t read(RF24NetworkHeader& header, void* message, uint16_t maxlen = MAX_PAYLOAD_SIZE);
+    uint16_t read(RF24NetworkHeader& header, void* message, uint16_t maxlen = config_t::maxPayloadSize);
 
     /**
      * Send a message
      *
      * @note RF24Network now supports fragmentation for very long messages, send as normal. Fragmentation
      * may need to be enabled or configured by editing the RF24Network_config.h file. Default max payload size is 120 bytes.
+     * With `ENABLE_JUMBO_MESSAGES`, longer messages (up to 65535 bytes) are sent as jumbo messages,
+     * which only Linux nodes with `ENABLE_JUMBO_MESSAGES` can receive.
+     * @note With `ENABLE_DEFERRED_TX`, the last relay holds a message of an ACK type (65 - 127) back
+     * for 2 milliseconds without blocking, and delivers it (and sends the NETWORK_ACK that this
+     * function waits for) from a later update(). A relay that doesn't call update() delays it beyond
+     * `routeTimeout`.
      *
      * @code
      * uint32_t time = millis();
@@ -539,6 +1024,41 @@ public:
      */
     bool write(RF24NetworkHeader& header, const void* message, uint16_t len);
 
+#if defined(ENABLE_GATHER_WRITES) || defined(DOXYGEN_FORCED)
+    /**
+     * Send a message that is held in several buffers
+     * @note This needs to be enabled via `#define ENABLE_GATHER_WRITES` in RF24Network_config.h
+     *
+     * The parts are sent as one message, in order, without copying them to a contiguous buffer first.
+     * @code
+     * RF24NetworkIovec iov[] = {{&metadata, sizeof(metadata)}, {samples, sampleCount * 2}};
+     * RF24NetworkHeader header(00, 'S');
+     * network.writev(header, iov, 2);
+     * @endcode
+     * @param[in,out] header The header (envelope) of this message. See write()
+     * @param iov The parts of the message
+     * @param iovcnt The number of parts in @p iov
+     * @return Whether the message was successfully received. False if the parts add up to more than 65535 bytes.
+     */
+    bool writev(RF24NetworkHeader& header, const RF24NetworkIovec* iov, uint8_t iovcnt);
+
+    /**
+     * Send a message whose bytes are produced while it is sent
+     * @note This needs to be enabled via `#define ENABLE_GATHER_WRITES` in RF24Network_config.h
+     *
+     * @p producer fills in the payload of each frame as it is sent, so a large message can be read
+     * from flash or a ring buffer without holding all of it in RAM. Compression (see
+     * `FLAG_COMPRESSION`) isn't used for these messages, since it needs the whole message up front.
+     *
+     * @param[in,out] header The header (envelope) of this message. See write()
+     * @param producer The function that produces the message's bytes
+     * @param context A pointer that is passed to @p producer
+     * @param len The size of the message
+     * @return Whether the message was successfully received. False if @p producer aborted it.
+     */
+    bool write(RF24NetworkHeader& header, RF24NetworkProducer producer, void* context, uint16_t len);
+#endif
+
     /**@}*/
     /**
      * @name Advanced Configuration
@@ -652,72 +1172,337 @@ public:
     bool multicast(RF24NetworkHeader& header, const void* message, uint16_t len, uint8_t level = 7);
 
 #endif
+#if (defined(RF24NetworkMulticast) && defined(ENABLE_MULTICAST_DEDUP)) || defined(DOXYGEN_FORCED)
 
     /**
-     * Writes a direct (unicast) payload. This allows routing or sending messages outside of the usual routing paths.
-     * The same as write, but a physical address is specified as the last option.
-     * The payload will be written to the physical address, and routed as necessary by the recipient.
+     * Return the number of received multicast frames that were dropped as duplicates
+     * @note This needs to be enabled via `#define ENABLE_MULTICAST_DEDUP` in RF24Network_config.h
+     *
+     * A multicast frame is a duplicate when a frame with the same header and payload was received
+     * within the last @ref MULTICAST_DEDUP_TIMEOUT milliseconds. This commonly happens when several
+     * relay nodes (see multicastRelay) are in range of each other. Duplicates are neither enqueued
+     * nor relayed again.
+     *
+     * Frames are compared by their source, id, type and a CRC-16 of the frame, so a message is only
+     * dropped if it repeats an earlier message's header (including the id, which is new for every
+     * RF24NetworkHeader that is constructed) and payload within that window. An application that
+     * multicasts the same header and payload again on purpose needs to wait @ref MULTICAST_DEDUP_TIMEOUT
+     * milliseconds in between.
      */
-    bool write(RF24NetworkHeader& header, const void* message, uint16_t len, uint16_t writeDirect);
+    uint32_t multicastDuplicates(void) const { return multicast_duplicates; }
+
+#endif
+#if defined(ENABLE_UNICAST_DEDUP) || defined(DOXYGEN_FORCED)
 
     /**
-     * Sleep this node - For AVR devices only
-     * @note NEW - Nodes can now be slept while the radio is not actively transmitting. This must be manually enabled by uncommenting
-     * the `#define ENABLE_SLEEP_MODE` in RF24Network_config.h
-     * @note The watchdog timer should be configured in the sketch's `setup()` if using sleep mode.
-     * This function will sleep the node, with the radio still active in receive mode. See setup_watchdog().
-     *
-     * The node can be awoken in two ways, both of which can be enabled simultaneously:
-     * 1. An interrupt - usually triggered by the radio receiving a payload. Must use pin 2 (interrupt 0) or 3 (interrupt 1) on Uno, Nano, etc.
-     * 2. The watchdog timer waking the MCU after a designated period of time, can also be used instead of delays to control transmission intervals.
-     *
-     * @code
-     * if(!network.available())
-     *     network.sleepNode(1, 0); // Sleep the node for 1 second or a payload is received
-     *
-     * // Other options:
-     * network.sleepNode(0, 0);     // Sleep this node for the designated time period, or a payload is received.
-     * network.sleepNode(1, 255);   // Sleep this node for 1 cycle. Do not wake up until then, even if a payload is received ( no interrupt )
-     * @endcode
-     *
-     * @param cycles: The node will sleep in cycles of 1s. Using 2 will sleep 2 WDT cycles, 3 sleeps 3WDT cycles...
-     * @param interruptPin: The interrupt number to use (0, 1) for pins 2 and 3 on Uno & Nano. More available on Mega etc.
-     * Setting this parameter to 255 will disable interrupt wake-ups.
-     * @param INTERRUPT_MODE an identifying number to indicate what type of state for which the @p interrupt_pin will be used to wake up the radio.
-     * | @p INTERRUPT_MODE | type of state |
-     * |:-----------------:|:-------------:|
-     * | 0 | LOW      |
-     * | 1 | RISING   |
-     * | 2 | FALLING  |
-     * | 3 | CHANGE   |
-     * @return True if sleepNode completed normally, after the specified number of cycles. False if sleep was interrupted
+     * Return the number of received unicast messages that were dropped as duplicates
+     * @note This needs to be enabled via `#define ENABLE_UNICAST_DEDUP` in RF24Network_config.h
+     *
+     * The last 32 message IDs received from each of up to @ref UNICAST_DEDUP_SOURCES source nodes
+     * are remembered. A message that repeats one of those IDs is dropped instead of being
+     * delivered again. This happens when a network ACK is lost and the sending application
+     * retransmits a message that was actually delivered.
+     * @warning With this enabled, every new message must use a newly constructed
+     * RF24NetworkHeader (which assigns a new RF24NetworkHeader::id). Only retransmissions of the
+     * same message should reuse a header.
      */
-    bool sleepNode(unsigned int cycles, int interruptPin, uint8_t INTERRUPT_MODE = 0); //added interrupt mode support (default 0=LOW)
+    uint32_t unicastDuplicates(void) const { return unicast_duplicates; }
+
+#endif
+#if defined(ENABLE_ACK_PIGGYBACK) || defined(DOXYGEN_FORCED)
 
     /**
-     * This node's parent address
+     * Return the number of NETWORK_ACKs that arrived piggybacked on a user message
+     * @note This needs to be enabled via `#define ENABLE_ACK_PIGGYBACK` in RF24Network_config.h
      *
-     * @return This node's parent address, or 65535 (-1 when casted to a signed int16_t) if this is the master node.
+     * update() returns the message's own type for these (see @ref NETWORK_PIGGYBACK_ACK), so
+     * this count is how the application can tell that they carried an ACK as well.
      */
-    uint16_t parent() const;
+    uint32_t piggybackedAcks(void) const { return piggyback_acks; }
 
-    /**
-     * Provided a node address and a pipe number, will return the RF24Network address of that child pipe for that node.
-     */
-    uint16_t addressOfPipe(uint16_t node, uint8_t pipeNo);
+#endif
+#if defined(ENABLE_FLOW_CONTROL) || defined(DOXYGEN_FORCED)
 
     /**
-     * Validate a network address as a proper logical address
-     * @note Addresses are specified in octal form, ie 011, 034.
-     * Review [RF24Network addressing](addressing.md) for more information.
-     * @param node The specified logical address of a network node.
-     * @return True if the specified `node` address is a valid network address, otherwise false.
-     * @remark This function will validate an improper address of `0100` as it is the reserved
-     * @ref NETWORK_MULTICAST_ADDRESS used for multicasted messages.
+     * Check if a node asked this node to stop sending to it
+     * @note This needs to be enabled via `#define ENABLE_FLOW_CONTROL` in RF24Network_config.h
+     *
+     * A node pauses its senders with a @ref NETWORK_FLOW_CONTROL message when its incoming frame
+     * buffer is nearly full. While paused, write() returns false for messages to that node
+     * (without transmitting them) unless they fit in the buffer space it reported. The pause ends
+     * after the reported duration, or sooner when the node has made room again.
+     *
+     * @param to_node The logical address of the destination node
+     * @return True if a pause from @p to_node is in effect
      */
-    bool is_valid_address(uint16_t node);
+    bool isPaused(uint16_t to_node);
+
+#endif
+#if defined(ENABLE_TYPE_HANDLERS) || defined(DOXYGEN_FORCED)
+
+    /**
+     * Register a function that is called for each received message of a certain header type
+     * @note This needs to be enabled via `#define ENABLE_TYPE_HANDLERS` in RF24Network_config.h
+     *
+     * The handler is called directly from update() (by an array lookup) as soon as a message is
+     * complete, and the message isn't loaded into the user cache. This avoids the peek(),
+     * `switch (header.type)` and read() sequence, along with its copies of each message.
+     * Set @ref FLAG_DROP_UNHANDLED in `networkFlags` to also drop user messages without a
+     * handler before they are cached.
+     *
+     * @code
+     * void onSensor(RF24NetworkHeader& header, const uint8_t* message, uint16_t len, void* context)
+     * {
+     *     memcpy(context, message, rf24_min(len, sizeof(sensorData)));
+     * }
+     *
+     * network.setHandler('S', onSensor, &sensorData);
+     * network.networkFlags |= FLAG_DROP_UNHANDLED;
+     * @endcode
+     *
+     * @param type The header type, below @ref NETWORK_HANDLER_TYPES. System types (128 - 255) are
+     * dispatched as well (and are no longer returned by update() when `returnSysMsgs` is set),
+     * except the internally handled fragment types, @ref EXTERNAL_DATA_TYPE and @ref NETWORK_ACK.
+     * @param handler The function to call, or `NULL` to remove the type's handler
+     * @param context A pointer that is passed to the handler as is
+     * @return False if a handler can't be registered for @p type
+     */
+    bool setHandler(uint8_t type, RF24NetworkHandler handler, void* context = NULL);
+
+#endif
+#if defined(ENABLE_FRAGMENT_STREAMING) || defined(DOXYGEN_FORCED)
 
-    /**@}*/
+    /**
+     * Register a function that receives fragmented messages piece by piece, as they arrive
+     * @note This needs to be enabled via `#define ENABLE_FRAGMENT_STREAMING` in RF24Network_config.h
+     *
+     * Fragmented messages are normally re-assembled in a buffer of up to `MAX_PAYLOAD_SIZE` bytes,
+     * and reach the application once they are complete. The handler is offered each fragmented
+     * message instead, when its first fragment arrives. If it accepts the message, the payload of
+     * each fragment is passed to it in order, and the message is never buffered. So a node with
+     * little RAM can receive large transfers (ie: a firmware update written straight to flash),
+     * larger than its own `MAX_PAYLOAD_SIZE`.
+     *
+     * @code
+     * bool onFragment(uint8_t event, const RF24NetworkHeader& header, const uint8_t* data, uint16_t len, void* context)
+     * {
+     *     switch (event) {
+     *         case RF24NETWORK_FRAGMENT_START: return header.from_node == 00; // only from the master
+     *         case RF24NETWORK_FRAGMENT_CHUNK: return flash.append(data, len);
+     *         case RF24NETWORK_FRAGMENT_END: flash.commit(header.type); break;
+     *         case RF24NETWORK_FRAGMENT_ABORT: flash.discard(); break;
+     *     }
+     *     return true;
+     * }
+     *
+     * network.setFragmentHandler(onFragment);
+     * @endcode
+     *
+     * @note One message is streamed at a time. The fragmented messages of other nodes meanwhile
+     * are re-assembled as usual. Compressed messages (see `FLAG_COMPRESSION`) and jumbo messages
+     * are always re-assembled, and a message that the sender repeats as a whole is streamed again.
+     * A message is aborted when none of its fragments arrived for `FRAGMENT_STREAM_TIMEOUT`
+     * milliseconds (checked by update()), so a sender that stalls doesn't hold up the others.
+     *
+     * @param handler The function to call, or `NULL` to re-assemble all messages as usual
+     * @param context A pointer that is passed to the handler as is
+     */
+    void setFragmentHandler(RF24NetworkFragmentHandler handler, void* context = NULL);
+
+#endif
+#if defined(ENABLE_AGGREGATION) || defined(DOXYGEN_FORCED)
+
+    /**
+     * Send the small messages that write() is holding back for aggregation
+     * @note This needs to be enabled via `#define ENABLE_AGGREGATION` in RF24Network_config.h
+     *
+     * This is also done by update() once the oldest held message waited for `aggregateDelay`
+     * milliseconds, and by write() when the next message doesn't fit with the held ones.
+     *
+     * @return True if there were no held messages, or the @ref NETWORK_AGGREGATE frame (or a single
+     * held message) was sent successfully
+     */
+    bool flushAggregate(void);
+
+#endif
+#if defined(ENABLE_NEIGHBOR_ROUTES) || defined(DOXYGEN_FORCED)
+
+    /**
+     * Check if a node is in radio range, and remember it as a neighbor if it is
+     * @note This needs to be enabled via `#define ENABLE_NEIGHBOR_ROUTES` in RF24Network_config.h
+     *
+     * Routing normally follows the tree, so messages between nodes in different branches travel
+     * through their common ancestor. Messages to a neighbor (or one of its descendants) are sent
+     * directly to the neighbor instead, whenever that saves hops. If sending to a neighbor fails,
+     * it is forgotten and the message is sent along the tree.
+     *
+     * This sends a @ref NETWORK_NEIGHBOR_PROBE directly to @p node. update() also probes nodes
+     * that send messages to this node (except its parent and children), at most once every
+     * @ref NETWORK_NEIGHBOR_PROBE_INTERVAL milliseconds per node.
+     *
+     * @param node The logical address of the node to probe
+     * @return True if @p node acknowledged the probe and is now used as a neighbor
+     */
+    bool probeNeighbor(uint16_t node);
+
+    /**
+     * Check if a node is currently used as a neighbor
+     * @note This needs to be enabled via `#define ENABLE_NEIGHBOR_ROUTES` in RF24Network_config.h
+     * @param node The logical address of the node
+     * @return True if messages to @p node (or its descendants) can be sent directly to it
+     */
+    bool isNeighbor(uint16_t node);
+
+#endif
+#if defined(ENABLE_PATH_MTU) || defined(DOXYGEN_FORCED)
+
+    /**
+     * Find out the largest frame payload that every radio on the path to a node carries
+     * @note This needs to be enabled via `#define ENABLE_PATH_MTU` in RF24Network_config.h
+     *
+     * In networks that mix nRF24 radios (24 byte payloads) with nRF52 radios (up to 246 bytes),
+     * messages are normally fragmented for the smallest radio. This sends a @ref NETWORK_MTU_PROBE
+     * to @p node instead, and its reply is remembered for NETWORK_PATH_MTU_TIMEOUT milliseconds.
+     * write() then fragments messages to @p node for its path. write() also probes by itself,
+     * when a message to a node that wasn't probed (recently) needs more than
+     * @ref NETWORK_PATH_MTU_DEFAULT bytes. If a write with a larger payload fails, the node falls
+     * back to the default size until it is probed again.
+     *
+     * @note Every node on the path must have `ENABLE_PATH_MTU`, since nodes without it don't
+     * lower the probe's payload size. The reply arrives with a later update().
+     *
+     * @param node The logical address of the node to probe
+     * @return True if the probe was sent to the next hop
+     */
+    bool probePathMtu(uint16_t node);
+
+    /**
+     * The frame payload size that write() uses for messages to a node
+     * @note This needs to be enabled via `#define ENABLE_PATH_MTU` in RF24Network_config.h
+     * @param node The logical address of the node
+     * @return The probed payload size of the path to @p node, or @ref NETWORK_PATH_MTU_DEFAULT if
+     * it wasn't probed. Neither exceeds the payload size of this node's radio.
+     */
+    uint8_t pathMtu(uint16_t node);
+
+#endif
+#if defined(ENABLE_TDMA) || defined(DOXYGEN_FORCED)
+
+    /**
+     * Check if this node follows the TDMA schedule of its parent
+     * @note This needs to be enabled via `#define ENABLE_TDMA` in RF24Network_config.h
+     *
+     * A node follows the schedule of the last @ref NETWORK_TDMA_BEACON from its parent, until
+     * @ref NETWORK_TDMA_MISSED_BEACONS beacons in a row were missed. Meanwhile, frames to the parent
+     * are only sent in this node's slot, or in the contention slots if it has no slot (yet).
+     * write() waits for the next such slot, which takes up to one TDMA frame.
+     * @see tdmaSlotTime
+     */
+    bool isScheduled(void);
+
+#endif
+#if defined(ENABLE_GATEWAY) || defined(DOXYGEN_FORCED)
+
+    /**
+     * Hand the frames for a level 1 child's subtree over to another network instance
+     * @note This needs to be enabled via `#define ENABLE_GATEWAY` in RF24Network_config.h
+     *
+     * This lets a master node (00) use several radios on different channels, each serving some of
+     * the level 1 children. Frames that this instance would send to (or route towards) the
+     * subtree of @p child are sent through @p network instead, including relayed frames and
+     * NETWORK_ACKs, so nodes in different subtrees can still reach each other.
+     * ESBNetworkGateway sets this up for each of its radios.
+     *
+     * @param child The level 1 child (1 - 5), ie: 03 for the subtree of node 03
+     * @param network The instance that serves the subtree, or NULL for this instance
+     */
+    void routeSubtree(uint8_t child, ESBNetworkBase<radio_t, config_t>* network);
+
+#endif
+#if defined(ENABLE_CAPTURE) || defined(DOXYGEN_FORCED)
+
+    /**
+     * Register a function that records every radio frame that this node receives or sends
+     * @note This needs to be enabled via `#define ENABLE_CAPTURE` in RF24Network_config.h
+     *
+     * The function is called from update() for each received frame (before it's processed), and
+     * after each frame was sent, with the next hop, pipe and result (see RF24NetworkCapture).
+     * Frames sent with @ref FLAG_FAST_FRAG are reported as acknowledged until the last one, since
+     * the radio's result is only known at the end. On Linux, RF24NetworkPcap::capture() writes the
+     * frames to a pcap file.
+     *
+     * @param handler The function to call, or `NULL` to stop capturing
+     * @param context A pointer that is passed to the function as is
+     */
+    void setCapture(RF24NetworkCaptureHandler handler, void* context = NULL);
+
+#endif
+
+    /**
+     * Writes a direct (unicast) payload. This allows routing or sending messages outside of the usual routing paths.
+     * The same as write, but a physical address is specified as the last option.
+     * The payload will be written to the physical address, and routed as necessary by the recipient.
+     */
+    bool write(RF24NetworkHeader& header, const void* message, uint16_t len, uint16_t writeDirect);
+
+    /**
+     * Sleep this node - For AVR devices only
+     * @note NEW - Nodes can now be slept while the radio is not actively transmitting. This must be manually enabled by uncommenting
+     * the `#define ENABLE_SLEEP_MODE` in RF24Network_config.h
+     * @note The watchdog timer should be configured in the sketch's `setup()` if using sleep mode.
+     * This function will sleep the node, with the radio still active in receive mode. See setup_watchdog().
+     *
+     * The node can be awoken in two ways, both of which can be enabled simultaneously:
+     * 1. An interrupt - usually triggered by the radio receiving a payload. Must use pin 2 (interrupt 0) or 3 (interrupt 1) on Uno, Nano, etc.
+     * 2. The watchdog timer waking the MCU after a designated period of time, can also be used instead of delays to control transmission intervals.
+     *
+     * @code
+     * if(!network.available())
+     *     network.sleepNode(1, 0); // Sleep the node for 1 second or a payload is received
+     *
+     * // Other options:
+     * network.sleepNode(0, 0);     // Sleep this node for the designated time period, or a payload is received.
+     * network.sleepNode(1, 255);   // Sleep this node for 1 cycle. Do not wake up until then, even if a payload is received ( no interrupt )
+     * @endcode
+     *
+     * @param cycles: The node will sleep in cycles of 1s. Using 2 will sleep 2 WDT cycles, 3 sleeps 3WDT cycles...
+     * @param interruptPin: The interrupt number to use (0, 1) for pins 2 and 3 on Uno & Nano. More available on Mega etc.
+     * Setting this parameter to 255 will disable interrupt wake-ups.
+     * @param INTERRUPT_MODE an identifying number to indicate what type of state for which the @p interrupt_pin will be used to wake up the radio.
+     * | @p INTERRUPT_MODE | type of state |
+     * |:-----------------:|:-------------:|
+     * | 0 | LOW      |
+     * | 1 | RISING   |
+     * | 2 | FALLING  |
+     * | 3 | CHANGE   |
+     * @return True if sleepNode completed normally, after the specified number of cycles. False if sleep was interrupted
+     */
+    bool sleepNode(unsigned int cycles, int interruptPin, uint8_t INTERRUPT_MODE = 0); //added interrupt mode support (default 0=LOW)
+
+    /**
+     * This node's parent address
+     *
+     * @return This node's parent address, or 65535 (-1 when casted to a signed int16_t) if this is the master node.
+     */
+    uint16_t parent() const;
+
+    /**
+     * Provided a node address and a pipe number, will return the RF24Network address of that child pipe for that node.
+     */
+    uint16_t addressOfPipe(uint16_t node, uint8_t pipeNo);
+
+    /**
+     * Validate a network address as a proper logical address
+     * @note Addresses are specified in octal form, ie 011, 034.
+     * Review [RF24Network addressing](addressing.md) for more information.
+     * @param node The specified logical address of a network node.
+     * @return True if the specified `node` address is a valid network address, otherwise false.
+     * @remark This function will validate an improper address of `0100` as it is the reserved
+     * @ref NETWORK_MULTICAST_ADDRESS used for multicasted messages.
+     */
+    bool is_valid_address(uint16_t node);
+
+    /**@}*/
     /**
      * @name Deprecated
      *
@@ -765,7 +1550,7 @@ public:
      * outgoing or incoming).
      * @note The first 8 bytes of this buffer is latest handled frame's RF24NetworkHeader data.
      */
-    uint8_t frame_buffer[RF24NETWORK_MAX_FRAME_SIZE];
+    uint8_t frame_buffer[RF24NETWORK_FRAME_BUFFER_SIZE];
 
     /**
      * **Linux platforms only**
@@ -783,10 +1568,132 @@ public:
      *   network.external_queue.pop();
      * }
      * @endcode
+     * @note With `ENABLE_JUMBO_MESSAGES`, jumbo messages are only loaded into this queue if they
+     * fit in the `message_buffer` (`MAX_PAYLOAD_SIZE` bytes). Longer ones are dropped.
      */
 
 #if defined(RF24_LINUX) || defined(DOXYGEN_FORCED)
     std::queue<RF24NetworkFrame> external_queue;
+
+    /**
+     * **Linux platforms only**
+     *
+     * The maximum number of frames held in the user cache (read with read()). Each frame occupies
+     * about 1.5 KB, so this bounds the memory used when the application stops reading.
+     * Defaults to @ref NETWORK_QUEUE_FRAMES. 0 means unlimited.
+     * @see dropPolicy, droppedFrames()
+     */
+    uint32_t maxQueuedFrames;
+
+    /**
+     * **Linux platforms only**
+     *
+     * The maximum number of frames held in the `external_queue`.
+     * Defaults to @ref NETWORK_EXTERNAL_QUEUE_FRAMES. 0 means unlimited.
+     * @see dropPolicy, droppedExternalFrames()
+     */
+    uint32_t maxExternalFrames;
+
+    /**
+     * **Linux platforms only**
+     *
+     * Which frame is dropped when a frame is received while its queue holds `maxQueuedFrames` (or
+     * `maxExternalFrames`) frames: @ref NETWORK_DROP_NEWEST (default) or @ref NETWORK_DROP_OLDEST.
+     * This can be overridden for individual header types with setDropPolicy().
+     */
+    uint8_t dropPolicy;
+
+    /**
+     * **Linux platforms only**
+     *
+     * Set the drop policy used for received frames of a certain header type, instead of `dropPolicy`.
+     * @code
+     * // Only the latest sensor readings matter
+     * network.setDropPolicy(SENSOR_TYPE, NETWORK_DROP_OLDEST);
+     * @endcode
+     * @param type The RF24NetworkHeader::type of the received frames
+     * @param policy @ref NETWORK_DROP_NEWEST or @ref NETWORK_DROP_OLDEST. Any other value reverts
+     * the type to `dropPolicy`.
+     * @note With `ENABLE_FAIR_QUEUING`, a full cache drops from the source with the most queued
+     * frames, which can be another source than the received frame's (see `maxSourceQueue`).
+     */
+    void setDropPolicy(uint8_t type, uint8_t policy);
+
+    /**
+     * **Linux platforms only**
+     *
+     * @return The number of frames dropped because the user cache held `maxQueuedFrames` frames
+     */
+    uint32_t droppedFrames(void) const { return frame_queue_drops; }
+
+    /**
+     * **Linux platforms only**
+     *
+     * @return The number of frames dropped because the `external_queue` held `maxExternalFrames` frames
+     */
+    uint32_t droppedExternalFrames(void) const { return external_queue_drops; }
+#endif
+#if defined(ENABLE_FAIR_QUEUING) || defined(DOXYGEN_FORCED)
+
+    /**
+     * @brief The most of the user cache that the messages of a single source can occupy
+     * @note This needs to be enabled via `#define ENABLE_FAIR_QUEUING` in RF24Network_config.h
+     *
+     * Received messages are queued per source: one for each child of this node (the messages
+     * from anywhere in its subtree), and one for all others (from the parent's side, or this
+     * node). peek() and read() serve the sources by deficit round robin (in turns of
+     * @ref NETWORK_FAIR_QUANTUM bytes), so a burst from one subtree doesn't delay the messages of
+     * the others. A source that holds this much drops its own messages (according to the drop
+     * policy on Linux), instead of filling the cache for everyone. A source without queued
+     * messages can always queue one.
+     *
+     * When the whole cache is full on Linux, the source with the most queued frames loses one.
+     * If that is another source than the received frame's, the drop policy of the type of its
+     * newest frame decides whether that newest frame or its oldest frame is dropped.
+     *
+     * Counted in frames on Linux (defaults to half of `maxQueuedFrames`), and in bytes of the
+     * `frame_queue` buffer on other devices (defaults to half of the buffer). 0 means no limit.
+     */
+    uint16_t maxSourceQueue;
+#endif
+#if (defined(ENABLE_JUMBO_MESSAGES) && defined(RF24_LINUX)) || defined(DOXYGEN_FORCED)
+
+    /**
+     * **Linux platforms only**
+     *
+     * @brief The largest jumbo message that is re-assembled
+     * @note This needs to be enabled via `#define ENABLE_JUMBO_MESSAGES` in RF24Network_config.h
+     *
+     * Messages larger than the sender's `MAX_PAYLOAD_SIZE` are sent as jumbo messages, and
+     * re-assembled in buffers that grow as their fragments arrive, so their size isn't bound by
+     * this node's `MAX_PAYLOAD_SIZE`. Longer messages are dropped, which also bounds the memory
+     * used by each sender. Defaults to @ref NETWORK_JUMBO_MAX_SIZE.
+     *
+     * Use a large enough `maxlen` with read() to receive the whole message.
+     */
+    uint16_t maxJumboSize;
+#endif
+#if defined(ENABLE_COALESCING) || defined(DOXYGEN_FORCED)
+
+    /**
+     * Keep only the latest unread message of a header type from each node
+     * @note This needs to be enabled via `#define ENABLE_COALESCING` in RF24Network_config.h
+     *
+     * For periodic readings, only the newest value matters. When a message of a coalesced type is
+     * received while the user cache still holds an unread one with the same type from the same
+     * node, the older message is removed, and the new one is queued at the end. So the cache holds
+     * at most one message per node and type, and the application always reads fresh values, even
+     * if it falls behind.
+     * @code
+     * network.setCoalescing(SENSOR_TYPE);
+     * @endcode
+     * @param type The RF24NetworkHeader::type of the received messages
+     * @param enable False to queue every message of the type again (the default)
+     */
+    void setCoalescing(uint8_t type, bool enable = true);
+
+    /** @return Whether the messages of @p type are coalesced. See setCoalescing() */
+    bool isCoalesced(uint8_t type) const { return coalesce_types[type >> 3] & (1 << (type & 7)); }
 #endif
 
 #if (!defined(DISABLE_FRAGMENTATION) && !defined(RF24_LINUX)) || defined(DOXYGEN_FORCED)
@@ -826,6 +1733,9 @@ public:
      * | @ref NETWORK_PING          |
      * | @ref NETWORK_POLL (With multicast enabled) |
      * | @ref NETWORK_REQ_ADDRESS   |
+     *
+     * Fragments, @ref EXTERNAL_DATA_TYPE, @ref NETWORK_STREAM_DATA and @ref NETWORK_STREAM_ACK
+     * messages are still queued.
      */
     bool returnSysMsgs;
 
@@ -844,6 +1754,51 @@ public:
      * during experimental development.
      */
     uint8_t networkFlags;
+#if defined(ENABLE_AGGREGATION) || defined(DOXYGEN_FORCED)
+
+    /**
+     * @brief The longest time (in milliseconds) that small messages are held back for aggregation
+     * @note This needs to be enabled via `#define ENABLE_AGGREGATION` in RF24Network_config.h
+     *
+     * When this isn't 0, write() doesn't send small user messages that are routed through the same
+     * neighbor right away. Instead, it packs them (with a 4 byte sub-header each) into a single
+     * @ref NETWORK_AGGREGATE frame, which needs a single radio transmission. This applies to
+     * messages of up to `(payload size of a frame - 8) / 2` bytes (8 bytes with 32 byte frames) that
+     * don't wait for a @ref NETWORK_ACK. write() returns true as soon as such a message is held
+     * back. Call flushAggregate() to send the held messages (and learn the result) right away.
+     *
+     * Defaults to 0 (messages are sent right away).
+     * @warning The neighbors of this node (and the nodes that they relay the messages through)
+     * must use `ENABLE_AGGREGATION` as well.
+     */
+    uint8_t aggregateDelay;
+#endif
+#if defined(ENABLE_TDMA) || defined(DOXYGEN_FORCED)
+
+    /**
+     * @brief The length (in milliseconds) of the TDMA slots that this node schedules for its children
+     * @note This needs to be enabled via `#define ENABLE_TDMA` in RF24Network_config.h
+     *
+     * When this isn't 0, update() starts a TDMA frame with a @ref NETWORK_TDMA_BEACON whenever the
+     * previous frame is over. The beacon assigns a slot to each child that was heard from within
+     * the last @ref NETWORK_TDMA_IDLE milliseconds, followed by `tdmaContentionSlots` slots that
+     * are shared by the other children (new ones start sending there). So children don't collide
+     * when sending to this node, even when the parent is busy.
+     *
+     * The slot should fit a frame with its retries (see `txTimeout`). Defaults to 0 (no beacons).
+     * @note update() must be called often enough to send the beacons on time, and this node must
+     * not be at multicast level 4 (its children have no multicast level to receive them).
+     */
+    uint8_t tdmaSlotTime;
+
+    /**
+     * @brief The number of contention slots at the end of each TDMA frame
+     * @note This needs to be enabled via `#define ENABLE_TDMA` in RF24Network_config.h
+     *
+     * Defaults to 1. Children without a slot can't send to this node if this is 0.
+     */
+    uint8_t tdmaContentionSlots;
+#endif
 
 protected:
 #if defined(RF24NetworkMulticast)
@@ -894,7 +1849,7 @@ private:
      * @brief Enqueue a frame (referenced by its beginning header) in the node's queue.
      * @returns
      * - 0 if queue's size is maxed out
-     * - 1 if frame is successfully enqueued
+     * - 1 if frame is successfully enqueued (or dropped as a duplicate)
      * - 2 if EXTERNAL_DATA is detected (indicating that it is in the queue and should be
      *   handled by an external system like RF24Gateway or RF24Ethernet).
      */
@@ -917,10 +1872,16 @@ private:
      */
     bool _write(RF24NetworkHeader& header, const void* message, uint16_t len, uint16_t writeDirect);
 
+    /*
+     * The body of the public write() functions, which picks the frame size for the destination.
+     * With `ENABLE_GATHER_WRITES`, a `producer` that isn't NULL produces the message instead of `message`
+     */
+    bool write(RF24NetworkHeader& header, const void* message, uint16_t len, uint16_t writeDirect, RF24NetworkProducer producer, void* context);
+
     /*
      * The main write function where fragmentation and processing of the payload is initiated
      */
-    inline bool main_write(RF24NetworkHeader& header, const void* message, uint16_t len, uint16_t writeDirect);
+    inline bool main_write(RF24NetworkHeader& header, const void* message, uint16_t len, uint16_t writeDirect, RF24NetworkProducer producer, void* context);
 
     struct logicalToPhysicalStruct
     {
@@ -950,35 +1911,176 @@ private:
     /* Returns a logical address for the first child en route to a child node */
     uint16_t direct_child_route_to(uint16_t node);
 
+    /* The pipe of the child whose subtree holds `node`, or 0 if it isn't a descendant */
+    uint8_t child_pipe(uint16_t node);
+
     /***********************************************************************/
 
     radio_t& radio; /** Underlying radio driver, provides link/physical layers */
 
     uint8_t frame_size; /* The outgoing frame's total size including the header info. Ranges [8, MAX_PAYLOAD_SIZE] */
 
+    uint8_t tx_frames;      /* Frames passed to the radio (wraps), to charge update()'s own sends to its budget */
+    bool budget_exhausted;  /* Whether the last call to update(uint8_t, uint32_t) used up its budget */
+
     unsigned int max_frame_payload_size = RF24NETWORK_MAX_FRAME_SIZE - sizeof(RF24NetworkHeader); /* always 24 bytes to compensate for the frame's header */
 
+#if defined(ENABLE_COMPRESSION)
+    static_assert(config_t::maxPayloadSize <= NETWORK_COMPRESSION_MAX_SIZE, "With ENABLE_COMPRESSION, the maxPayloadSize of a configuration policy can't exceed NETWORK_COMPRESSION_MAX_SIZE");
+#endif
 #if defined(RF24_LINUX)
-    std::queue<RF24NetworkFrame> frame_queue;
+    static_assert(config_t::maxPayloadSize <= MAX_PAYLOAD_SIZE, "The maxPayloadSize of a configuration policy can't exceed MAX_PAYLOAD_SIZE on Linux");
+
+    /* A queue of frames that can also be searched (the std::queue's container is protected) */
+    struct frameQueue : std::queue<RF24NetworkFrame>
+    {
+        using std::queue<RF24NetworkFrame>::c;
+    };
+    frameQueue frame_queue;
     std::map<uint16_t, RF24NetworkFrame> frameFragmentsCache;
     bool appendFragmentToFrame(RF24NetworkFrame frame);
+    #if defined(ENABLE_JUMBO_MESSAGES)
+    /* A jumbo message being re-assembled */
+    struct jumboMessage
+    {
+        RF24NetworkHeader header;
+        uint16_t fragments; /* The fragment count of the last received fragment */
+        std::vector<uint8_t> buffer;
+    };
+    std::map<uint16_t, jumboMessage> jumboFragmentsCache;
+
+    /* Adds a jumbo fragment to its message. The completed message is moved to the frameFragmentsCache */
+    bool appendJumboFragment(const RF24NetworkFrame& frame);
+
+    /*
+     * The payloads of completed jumbo messages that don't fit in a frame's message_buffer. Their
+     * frames have a message_size over MAX_PAYLOAD_SIZE, and hold the key in the message_buffer
+     */
+    std::map<uint32_t, std::vector<uint8_t> > jumbo_payloads;
+    uint32_t jumbo_key; /* The key of the last stored jumbo payload */
+
+    /* The key of a frame's jumbo payload */
+    static uint32_t jumbo_payload_key(const RF24NetworkFrame& frame)
+    {
+        uint32_t key;
+        memcpy(&key, frame.message_buffer, sizeof(key));
+        return key;
+    }
+    #endif
+
+    /* The payload of a frame in the user cache */
+    const uint8_t* frame_payload(const RF24NetworkFrame& frame)
+    {
+    #if defined(ENABLE_JUMBO_MESSAGES)
+        if (frame.message_size > sizeof(frame.message_buffer)) {
+            return jumbo_payloads[jumbo_payload_key(frame)].data();
+        }
+    #endif
+        return frame.message_buffer;
+    }
+
+    /* Frees the jumbo payload of a frame that leaves the user cache (or never enters it) */
+    void frame_release(const RF24NetworkFrame& frame)
+    {
+    #if defined(ENABLE_JUMBO_MESSAGES)
+        if (frame.message_size > sizeof(frame.message_buffer)) {
+            jumbo_payloads.erase(jumbo_payload_key(frame));
+        }
+    #else
+        (void)frame;
+    #endif
+    }
+    uint8_t type_drop_policy[256]; /* The drop policy for each header type (or 255 to use dropPolicy) */
+
+    /* The drop policy of received frames of a header type */
+    uint8_t drop_policy(uint8_t type) const { return type_drop_policy[type] == 255 ? dropPolicy : type_drop_policy[type]; }
+    uint32_t frame_queue_drops;
+    uint32_t external_queue_drops;
+
+    /* Pushes a received frame onto `queue`, applying the drop policy of the frame's type if it holds `limit` frames */
+    void push_frame(std::queue<RF24NetworkFrame>& queue, const RF24NetworkFrame& frame, uint32_t limit, uint32_t& drops);
+
+    /* The number of frames in the user cache */
+    uint32_t queued_frames(void);
+    #if defined(ENABLE_FAIR_QUEUING)
+    frameQueue fair_queues[NUM_PIPES]; /* The received frames of each source. The `frame_queue` holds the one read next */
+
+    /* Pushes a received frame onto the queue of its source, applying the limits and the drop policy of the dropped frame's type */
+    void fair_push(const RF24NetworkFrame& frame, uint32_t limit, uint32_t& drops);
+    #endif
 #else // Not Linux:
 
-    #if defined(DISABLE_USER_PAYLOADS)
-    uint8_t frame_queue[1];  /** Space for a small set of frames that need to be delivered to the app layer */
+    #if defined(ENABLE_SHARED_RX_BUFFER) && !defined(DISABLE_FRAGMENTATION)
+    uint8_t frame_queue[config_t::userPayloads || config_t::fragmentation ? config_t::maxPayloadSize + FRAME_HEADER_SIZE : 1]; /** Space for a small set of frames that need to be delivered to the app layer, and the message being re-assembled */
     #else
-    uint8_t frame_queue[MAIN_BUFFER_SIZE]; /** Space for a small set of frames that need to be delivered to the app layer */
+    uint8_t frame_queue[config_t::userPayloads ? config_t::maxPayloadSize + FRAME_HEADER_SIZE : 1]; /** Space for a small set of frames that need to be delivered to the app layer */
     #endif
 
-    uint8_t* next_frame;                                 /** Pointer into the @p frame_queue where we should place the next received frame */
+    uint8_t* next_frame; /** Pointer into the @p frame_queue where we should place the next received frame */
 
     #if !defined(DISABLE_FRAGMENTATION)
-    RF24NetworkFrame frag_queue;                         /* a cache for re-assembling incoming message fragments */
-    uint8_t frag_queue_message_buffer[MAX_PAYLOAD_SIZE]; //frame size + 1
+    RF24NetworkFrame frag_queue; /* a cache for re-assembling incoming message fragments */
+        #if defined(ENABLE_COMPRESSION)
+    bool frag_compressed; /* Whether the message in the frag_queue is compressed */
+        #endif
+        #if defined(ENABLE_SHARED_RX_BUFFER)
+    /* Whether a message of `len` bytes can be re-assembled (in place) at the end of the frame_queue */
+    bool frag_fits(uint16_t len) { return next_frame - frame_queue + FRAME_HEADER_SIZE + len <= (uint16_t)sizeof(frame_queue); }
+        #else
+    uint8_t frag_queue_message_buffer[config_t::fragmentation ? config_t::maxPayloadSize : 1]; //frame size + 1
+        #endif
+    #endif
+
+    #if defined(ENABLE_FAIR_QUEUING) || defined(ENABLE_COALESCING)
+    /* The size of the frame at `frame` in the `frame_queue`, including its padding */
+    uint16_t queued_size(const uint8_t* frame);
+
+    /* The unread message of `type` from `from_node` that a new one replaces, if the type is coalesced. Otherwise NULL */
+    uint8_t* coalesce_find(uint16_t from_node, uint8_t type);
     #endif
+    #if defined(ENABLE_FAIR_QUEUING)
+    uint8_t* fair_head; /* The frame in the `frame_queue` that is read next. NULL until chosen */
+
+    /* The first frame of `source` in the `frame_queue`, or NULL */
+    uint8_t* fair_find(uint8_t source);
 
+    /* The bytes left in the share of `from_node`'s source, not counting the frame at `replaced`. 0xFFFF if the source may queue a message of any size */
+    uint16_t fair_space(uint16_t from_node, const uint8_t* replaced);
+
+    /* Whether a message of `len` bytes from `from_node` fits in the share of its source, once it replaces the frame at `replaced` (or NULL) */
+    bool fair_allowed(uint16_t from_node, uint16_t len, const uint8_t* replaced);
+    #endif
 #endif // Linux/Not Linux
 
+#if defined(ENABLE_FAIR_QUEUING)
+    uint32_t fair_deficit[NUM_PIPES]; /* The bytes that each source may still be served in its turn (wider than any message) */
+    uint8_t fair_next;                /* The source whose turn it is */
+    bool fair_fresh;                  /* Whether `fair_next` hasn't been given its quantum for this turn yet */
+
+    /* The source of a received message: the pipe of the child whose subtree sent it, or 0 */
+    uint8_t fair_source(uint16_t from_node) { return from_node == node_address ? 0 : child_pipe(from_node); }
+
+    /* The size of the next message of `source`, or 0 if it has none */
+    uint32_t fair_head_size(uint8_t source);
+
+    /* Chooses the source of the next message by deficit round robin. Returns NUM_PIPES if there are no messages */
+    uint8_t fair_select(void);
+
+    /* Makes the next message chosen by fair_select() the one that peek() and read() return */
+    void fair_stage(void);
+#endif
+#if defined(ENABLE_COALESCING)
+    uint8_t coalesce_types[32]; /* A bit for each header type whose messages are coalesced */
+
+    #if defined(RF24_LINUX)
+    /* Replaces the unread message of the frame's type from its sender with `frame`, if the type is coalesced. Returns false if there is none */
+    bool coalesce(const RF24NetworkFrame& frame);
+    #else
+    /* Removes the frame at `frame` (found by coalesce_find(), or NULL) from the `frame_queue` */
+    void coalesce_remove(uint8_t* frame);
+    #endif
+#endif
+
     uint16_t parent_node; /** Our parent's node address */
     uint8_t parent_pipe;  /** The pipe our parent uses to listen to us */
     uint16_t node_mask;   /** The bits which contain significant node address information */
@@ -996,9 +2098,341 @@ private:
     uint16_t levelToAddress(uint8_t level);
 #endif
 
+#if defined(RF24NetworkMulticast) && defined(ENABLE_MULTICAST_DEDUP)
+    /* A recently received multicast frame */
+    struct multicastDedupEntry
+    {
+        uint16_t from_node;
+        uint16_t id;
+        uint16_t time; /* The lower 16 bits of millis() when the frame was received */
+        uint16_t crc;  /* CRC-16 of the frame from its id on, so frames reusing a header aren't mistaken for duplicates */
+        uint8_t type;
+        uint8_t reserved;
+    };
+    multicastDedupEntry multicast_dedup[MULTICAST_DEDUP_SIZE];
+    uint8_t multicast_dedup_next; /* The ring buffer position that is overwritten next */
+    uint32_t multicast_duplicates;
+
+    /* Returns true if the multicast frame in the `frame_buffer` was recently received, otherwise it is remembered */
+    bool is_multicast_duplicate(RF24NetworkHeader* header);
+#endif
+
+#if defined(ENABLE_UNICAST_DEDUP)
+    /* The sliding window of message IDs received from a single source node */
+    struct unicastDedupEntry
+    {
+        uint32_t time;    /* millis() when a message was last received from this node */
+        uint32_t window;  /* Bit N is set if the message ID `last_id - (N + 1)` was received */
+        uint16_t node;    /* The source node's logical address (0xFFFF for an unused entry) */
+        uint16_t last_id; /* The newest message ID received from this node */
+    };
+    unicastDedupEntry unicast_dedup[UNICAST_DEDUP_SOURCES];
+    uint8_t unicast_dedup_next; /* The entry that is reused next when a new source is seen */
+    uint32_t unicast_duplicates;
+
+    /* Returns true if a complete unicast message was already received, otherwise its ID is remembered */
+    bool is_unicast_duplicate(RF24NetworkHeader* header);
+#endif
+
+#if defined(ENABLE_FLOW_CONTROL)
+    /* A node involved in a NETWORK_FLOW_CONTROL pause */
+    struct flowControlEntry
+    {
+        uint32_t time;   /* For flow_paused: millis() when the pause ends. For flow_pausing: millis() when the pause was sent */
+        uint16_t node;   /* The node's logical address (0xFFFF for an unused entry) */
+        uint16_t credit; /* For flow_paused: the remaining bytes that the paused-by node can still accept */
+    };
+    flowControlEntry flow_paused[FLOW_CONTROL_NODES];  /* Destination nodes that paused this node */
+    flowControlEntry flow_pausing[FLOW_CONTROL_NODES]; /* Source nodes that this node paused */
+
+    /* Called after a frame from `from_node` is enqueued. Pauses the sender if the frame buffer is nearly full */
+    void flow_control(uint16_t from_node);
+
+    /* Called from update(). Resumes paused senders once the frame buffer has room again */
+    void flow_resume(void);
+
+    /* Processes a NETWORK_FLOW_CONTROL message in the `frame_buffer` */
+    void flow_received(RF24NetworkHeader* header);
+
+    /* Sends a NETWORK_FLOW_CONTROL message */
+    void send_flow_control(uint16_t to_node, uint16_t pause, uint16_t credit);
+
+    /* Returns the entry for `node` in `table`, or NULL */
+    flowControlEntry* flow_entry(flowControlEntry* table, uint16_t node);
+
+    /* Returns false if a pause from `to_node` doesn't leave room for a message of `len` bytes */
+    bool flow_allowed(uint16_t to_node, uint16_t len);
+#endif
+
+#if defined(ENABLE_TYPE_HANDLERS)
+    /* A function registered with setHandler() */
+    struct typeHandler
+    {
+        RF24NetworkHandler handler;
+        void* context;
+    };
+    typeHandler handlers[NETWORK_HANDLER_TYPES]; /* Indexed by header type */
+
+    /* Returns true if a handler is registered for `type` */
+    bool has_handler(uint8_t type)
+    {
+    #if NETWORK_HANDLER_TYPES < 256
+        if (type >= NETWORK_HANDLER_TYPES) {
+            return false;
+        }
+    #endif
+        return handlers[type].handler != NULL;
+    }
+
+    /* Returns true if the complete message was passed to its handler (or dropped as unhandled) instead of being queued */
+    bool dispatch(RF24NetworkHeader& header, const uint8_t* message, uint16_t len);
+#endif
+
+#if defined(ENABLE_FRAGMENT_STREAMING)
+    RF24NetworkFragmentHandler fragment_handler;
+    void* fragment_context;
+    RF24NetworkHeader stream_header; /* The last fragment of the streamed message (its `reserved` field counts down) */
+    uint16_t stream_size;            /* The bytes handed over so far */
+    uint32_t stream_time;            /* The millis() timestamp of the last fragment handed over */
+    bool stream_active;
+
+    /* Hands a fragment to the fragment handler, returns false if it must be re-assembled as usual */
+    bool stream_fragment(RF24NetworkHeader header, const uint8_t* payload, uint16_t size);
+
+    /* Ends the streamed message with RF24NETWORK_FRAGMENT_ABORT */
+    void stream_abort(void);
+#endif
+
+#if defined(ENABLE_COMPACT_FRAGMENTS)
+    /* A fragmented message crossing a link, so its continuation fragments can be sent with a compact header */
+    struct compactContext
+    {
+        uint16_t from_node;
+        uint16_t to_node;
+        uint16_t id;
+        uint8_t link; /* The neighbor's link_index() (0xFF for an unused entry) */
+    };
+    compactContext compact_tx[NETWORK_COMPACT_CONTEXTS]; /* Messages whose first fragment was sent to a neighbor */
+    compactContext compact_rx[NETWORK_COMPACT_CONTEXTS]; /* Messages whose first fragment was received from a neighbor */
+    uint8_t compact_tx_next;
+    uint8_t compact_rx_next;
+    uint8_t compact_links; /* Bit N is set if the neighbor with link_index() N supports compact headers */
+
+    /* Returns 0 for the parent, the pipe (1 - 5) of a direct child, or 0xFF for other nodes */
+    uint8_t link_index(uint16_t node);
+
+    /* Stores `context` in `table`, replacing an entry for the same link and source node */
+    void compact_store(compactContext* table, uint8_t& next, const compactContext& context);
+
+    /* Returns the only entry of `table` for `link` with the message ID low byte `id`, or NULL for none or several */
+    compactContext* compact_match(compactContext* table, uint8_t link, uint8_t id);
+
+    /* Returns the compact size of the frame in the `frame_buffer` written to `node` in `compact`, or 0 if it is sent as is */
+    uint8_t compact_frame(uint16_t node, uint8_t* compact);
+
+    /* Restores the header of a compact frame in the `frame_buffer`, returns false if the message is unknown */
+    bool expand_frame(void);
+
+    /* Sends a NETWORK_COMPACT_HELLO message */
+    void send_compact_hello(uint16_t to_node, uint8_t request);
+
+    /* Returns true if continuation fragments of a message to `to_node` can carry NETWORK_COMPACT_SAVING more bytes */
+    bool compact_route(uint16_t to_node, uint16_t writeDirect);
+#endif
+
+    /* Whether `type` is the first fragment of a standard or jumbo message */
+    static bool is_first_fragment(uint8_t type) { return type == NETWORK_FIRST_FRAGMENT || type == NETWORK_JUMBO_FIRST_FRAGMENT; }
+
+    /* Whether `type` is the last fragment of a standard or jumbo message */
+    static bool is_last_fragment(uint8_t type) { return type == NETWORK_LAST_FRAGMENT || type == NETWORK_JUMBO_LAST_FRAGMENT; }
+
+    /* Whether `type` is any fragment of a jumbo message */
+    static bool is_jumbo_fragment(uint8_t type) { return type >= NETWORK_JUMBO_FIRST_FRAGMENT && type <= NETWORK_JUMBO_LAST_FRAGMENT; }
+
+#if defined(ENABLE_AGGREGATION)
+    uint32_t aggregate_tx_time;                       /* millis() when the first held message was added */
+    uint8_t aggregate_tx[RF24NETWORK_MAX_FRAME_SIZE]; /* The NETWORK_AGGREGATE frame being filled with held messages (aligned for its header) */
+    uint8_t aggregate_rx[RF24NETWORK_MAX_FRAME_SIZE]; /* The received NETWORK_AGGREGATE frame being unpacked */
+    uint8_t aggregate_tx_size;                        /* The size of the frame in `aggregate_tx`. 0 if no messages are held */
+    uint8_t aggregate_rx_size;                        /* The size of the frame in `aggregate_rx`. 0 once it is unpacked */
+    uint8_t aggregate_rx_pos;                         /* The offset of the next sub-message in `aggregate_rx` */
+
+    /* Holds a message back for aggregation, returns false if it must be sent as usual */
+    bool aggregate(RF24NetworkHeader& header, const void* message, uint16_t len, uint16_t writeDirect);
+
+    /* Loads the next sub-message of `aggregate_rx` into the `frame_buffer` */
+    void unpack_aggregate(void);
+#endif
+
+#if defined(ENABLE_NEIGHBOR_ROUTES)
+    /* A node outside of the tree links that was probed */
+    struct neighborEntry
+    {
+        uint32_t time;  /* millis() when the node was last probed, heard from or failed */
+        uint16_t node;  /* NETWORK_MULTICAST_ADDRESS for an unused entry */
+        bool reachable; /* False if the node failed, so it isn't probed again for a while */
+    };
+    neighborEntry neighbors[NETWORK_NEIGHBORS];
+
+    /* Returns the neighbor that shortens the route to `to_node`, or NETWORK_MULTICAST_ADDRESS to use the tree */
+    uint16_t neighbor_route(uint16_t to_node);
+
+    /* Adds or refreshes a node in `neighbors`, replacing the oldest entry when full */
+    void neighbor_store(uint16_t node, bool reachable);
+
+    /* Marks a neighbor as unreachable, returns false if it wasn't a reachable neighbor */
+    bool neighbor_forget(uint16_t node);
+
+    /* Probes the sender of a received message if it may be a neighbor */
+    void neighbor_learn(uint16_t node);
+#endif
+
+#if defined(ENABLE_PATH_MTU)
+    /* The payload size of the path to a destination */
+    struct pathMtuEntry
+    {
+        uint32_t time;   /* millis() when the path was last probed or failed */
+        uint16_t node;   /* NETWORK_MULTICAST_ADDRESS for an unused entry */
+        uint8_t payload; /* 0 while it is unknown (the probe wasn't answered, or a write failed) */
+    };
+    pathMtuEntry path_mtus[NETWORK_PATH_MTU_NODES];
+
+    /* Returns the entry of `node`, or NULL */
+    pathMtuEntry* path_mtu_find(uint16_t node);
+
+    /* Adds or updates the entry of `node`, replacing the oldest entry when full */
+    void path_mtu_store(uint16_t node, uint8_t payload);
+
+    /* Returns the payload size for a message of `len` bytes to `node`, probing the path if that's worth it */
+    uint8_t path_payload_size(uint16_t node, uint16_t len);
+
+    /* Returns the largest payload that a frame of this node's radio carries */
+    uint8_t link_payload_size(void);
+#endif
+
+#if defined(ENABLE_ACK_PIGGYBACK)
+    /* A NETWORK_ACK waiting for a message to the same node */
+    struct heldAck
+    {
+        uint32_t time;    /* millis() when the ACK was held back */
+        uint16_t to_node; /* The node waiting for the ACK. NETWORK_MULTICAST_ADDRESS for an unused entry */
+        uint16_t id;      /* The ID of the acknowledged message */
+    };
+    heldAck held_acks[NETWORK_HELD_ACKS];
+    uint32_t piggyback_acks;
+
+    /* Holds a NETWORK_ACK back, returns false if it must be sent right away */
+    bool hold_ack(uint16_t to_node, uint16_t id);
+
+    /* Returns the held ACK for `to_node`, or 0xFF */
+    uint8_t held_ack(uint16_t to_node);
+
+    /* Sends the held ACKs that waited for NETWORK_ACK_HOLD milliseconds by themselves */
+    void send_held_acks(void);
+#endif
+
+#if defined(ENABLE_TDMA)
+    /* As a parent */
+    uint32_t tdma_heard[NUM_PIPES];  /* millis() when each child pipe was last heard from */
+    uint32_t tdma_beacon_time;       /* millis() when the last beacon was sent */
+    uint8_t tdma_children;           /* Bit N is set if the child on pipe N was heard from */
+    uint8_t tdma_beacon_slots;       /* The number of slots in the last beacon */
+
+    /* As a child */
+    uint32_t tdma_frame_start;                 /* millis() when the last beacon from the parent was received */
+    uint8_t tdma_schedule[NETWORK_TDMA_SLOTS]; /* The slots of the parent's schedule */
+    uint8_t tdma_slots;                        /* The number of slots in `tdma_schedule`. 0 if not scheduled */
+    uint8_t tdma_slot_time;                    /* The parent's slot length */
+
+    /* Sends a NETWORK_TDMA_BEACON to this node's children */
+    void send_beacon(void);
+
+    /* Records that the sender of the frame in the `frame_buffer` reached this node through a child */
+    void tdma_heard_from(uint16_t from_node);
+
+    /* Follows the schedule of a NETWORK_TDMA_BEACON from the parent in the `frame_buffer` */
+    void tdma_sync(void);
+
+    /* Waits for a slot in which this node may send to its parent */
+    void tdma_wait(void);
+#endif
+
+#if defined(ENABLE_GATEWAY)
+    ESBNetworkBase<radio_t, config_t>* gateway_routes[NUM_PIPES]; /* The instance that serves each level 1 child's subtree. NULL for this one */
+#endif
+
+#if defined(ENABLE_CAPTURE)
+    RF24NetworkCaptureHandler capture_handler; /* The function registered with setCapture() */
+    void* capture_context;
+
+    /* Passes a received or sent frame to the capture_handler */
+    void capture(const uint8_t* frame, uint8_t size, uint16_t node, uint8_t pipe, uint8_t flags, uint32_t time);
+#endif
+
+#if defined(ENABLE_DEFERRED_TX)
+    /* A frame waiting in the deferred transmission timer wheel */
+    struct deferredFrame
+    {
+        uint8_t frame[RF24NETWORK_FRAME_BUFFER_SIZE]; /* A copy of the `frame_buffer` at the time it was scheduled */
+        uint16_t to_node;                             /* The `to_node` passed to write(uint16_t, uint8_t) when fired */
+        uint8_t size;                                 /* The copied frame's size. 0 marks an unused slot */
+        uint8_t sendType;                             /* The `sendType` passed to write(uint16_t, uint8_t) when fired */
+        uint8_t next;                                 /* Index of the next frame in the same bucket (or 255 for none) */
+        uint32_t due;                                 /* The millis() timestamp at which this frame is written */
+    };
+    deferredFrame deferred[DEFERRED_TX_SLOTS];
+    uint8_t deferred_wheel[DEFERRED_TX_WHEEL_SIZE]; /* Heads of each bucket's list of frames (255 for none) */
+    uint8_t deferred_pos;                           /* The bucket of the wheel that was last processed */
+    uint8_t deferred_count;                         /* The number of frames waiting in the wheel */
+    bool deferred_firing;                           /* Asserted while a due frame is being written */
+    uint32_t deferred_time;                         /* The millis() timestamp of the last processed bucket */
+
+    /*
+     * Copies the frame currently in the `frame_buffer` into the timer wheel, to be written with
+     * `write(to_node, sendType)` once `delay_ms` milliseconds have passed.
+     *
+     * Returns false (and leaves the frame untouched) if `delay_ms` is 0 or all slots are in use.
+     */
+    bool schedule_write(uint16_t to_node, uint8_t sendType, uint16_t delay_ms);
+
+    /* Like schedule_write(), for a frame that is written at the millis() timestamp `due` (after any frames due at the same time) */
+    bool schedule_at(uint16_t to_node, uint8_t sendType, uint32_t due);
+
+    /*
+     * Called from update() instead of `write(to_node, TX_ROUTED)` for the frame in the `frame_buffer`.
+     * Defers an ACK-type frame (65 - 191) on its last hop by 2 milliseconds, and queues any frame to
+     * a node that has a routed frame waiting behind that frame.
+     *
+     * Returns false if the frame needs to be written right away (after the frames ahead of it).
+     */
+    bool defer_routed(uint16_t to_node);
+
+    /* Called from update() to write any frames in the timer wheel that are due */
+    void write_deferred(void);
+#endif
+
     /** @} */
 };
 
+/**
+ * The network layer with the configuration from RF24Network_config.h (see @ref RF24NetworkConfig)
+ *
+ * @tparam radio_t The `radio` object's type. Defaults to `RF24` for legacy behavior.
+ */
+template<class radio_t = RF24>
+class ESBNetwork : public ESBNetworkBase<radio_t, RF24NetworkConfig>
+{
+public:
+    /**
+     * Construct the network
+     *
+     * @param _radio The underlying radio driver instance
+     */
+    ESBNetwork(radio_t& _radio) : ESBNetworkBase<radio_t, RF24NetworkConfig>(_radio)
+    {
+    }
+};
+
 /**
  * A type definition of the template class `ESBNetwork` to maintain backward compatibility.
  *
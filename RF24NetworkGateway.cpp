@@ -0,0 +1,176 @@
+/*
+ Copyright (C) 2011 James Coliz, Jr. <maniacbug@ymail.com>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ version 2 as published by the Free Software Foundation.
+ */
+#include "RF24Network_config.h"
+
+#if defined(RF24_LINUX)
+    #include <string.h>
+    #if !defined(USE_RF24_LIB_SRC)
+        #include <RF24/RF24.h>
+    #endif
+#else
+    #include "RF24.h"
+    #if defined(ARDUINO_ARCH_NRF52) || defined(ARDUINO_ARCH_NRF52840) || defined(ARDUINO_NRF54L15)
+        #include <nrf_to_nrf.h>
+    #endif
+#endif
+#include "RF24Network.h"
+#include "RF24NetworkGateway.h"
+#if defined(USE_RF24_LIB_SRC)
+    #include <RF24.h>
+#endif
+
+#if defined(ENABLE_GATEWAY)
+/******************************************************************/
+
+template<class radio_t>
+ESBNetworkGateway<radio_t>::ESBNetworkGateway(void) : num_radios(0), next_read(0)
+{
+}
+
+/******************************************************************/
+
+template<class radio_t>
+bool ESBNetworkGateway<radio_t>::attach(ESBNetwork<radio_t>& network, uint8_t children_mask)
+{
+    if (num_radios >= GATEWAY_MAX_RADIOS) {
+        return false;
+    }
+    networks[num_radios] = &network;
+    children[num_radios] = children_mask;
+    ++num_radios;
+    return true;
+}
+
+/******************************************************************/
+
+template<class radio_t>
+void ESBNetworkGateway<radio_t>::begin(void)
+{
+    for (uint8_t i = 0; i < num_radios; ++i) {
+        networks[i]->begin(00);
+    }
+    // Every radio hands the frames for the other radios' subtrees over to them
+    for (uint8_t child = 1; child < NUM_PIPES; ++child) {
+        ESBNetwork<radio_t>* network = networkFor(child);
+        for (uint8_t i = 0; i < num_radios; ++i) {
+            networks[i]->routeSubtree(child, network);
+        }
+    }
+}
+
+/******************************************************************/
+
+template<class radio_t>
+uint8_t ESBNetworkGateway<radio_t>::update(void)
+{
+    uint8_t returnVal = 0;
+    for (uint8_t i = 0; i < num_radios; ++i) {
+        uint8_t result = networks[i]->update();
+        if (result) {
+            returnVal = result;
+        }
+    }
+    return returnVal;
+}
+
+/******************************************************************/
+
+template<class radio_t>
+uint8_t ESBNetworkGateway<radio_t>::next_available(void)
+{
+    for (uint8_t i = 0; i < num_radios; ++i) {
+        uint8_t radio = (next_read + i) % num_radios;
+        if (networks[radio]->available()) {
+            return radio;
+        }
+    }
+    return num_radios;
+}
+
+/******************************************************************/
+
+template<class radio_t>
+bool ESBNetworkGateway<radio_t>::available(void)
+{
+    return next_available() < num_radios;
+}
+
+/******************************************************************/
+
+template<class radio_t>
+uint16_t ESBNetworkGateway<radio_t>::peek(RF24NetworkHeader& header)
+{
+    uint8_t radio = next_available();
+    if (radio == num_radios) {
+        return 0;
+    }
+    return networks[radio]->peek(header);
+}
+
+/******************************************************************/
+
+template<class radio_t>
+uint16_t ESBNetworkGateway<radio_t>::read(RF24NetworkHeader& header, void* message, uint16_t maxlen)
+{
+    uint8_t radio = next_available();
+    if (radio == num_radios) {
+        return 0;
+    }
+    next_read = (radio + 1) % num_radios;
+    return networks[radio]->read(header, message, maxlen);
+}
+
+/******************************************************************/
+
+template<class radio_t>
+bool ESBNetworkGateway<radio_t>::write(RF24NetworkHeader& header, const void* message, uint16_t len)
+{
+    ESBNetwork<radio_t>* network = networkFor(header.to_node);
+    return network && network->write(header, message, len);
+}
+
+/******************************************************************/
+
+    #if defined(RF24NetworkMulticast)
+template<class radio_t>
+bool ESBNetworkGateway<radio_t>::multicast(RF24NetworkHeader& header, const void* message, uint16_t len, uint8_t level)
+{
+    bool ok = num_radios;
+    for (uint8_t i = 0; i < num_radios; ++i) {
+        // Each radio's children see the same message ID
+        RF24NetworkHeader copy = header;
+        ok &= networks[i]->multicast(copy, message, len, level);
+    }
+    return ok;
+}
+
+/******************************************************************/
+    #endif
+
+template<class radio_t>
+ESBNetwork<radio_t>* ESBNetworkGateway<radio_t>::networkFor(uint16_t node)
+{
+    if (!num_radios) {
+        return NULL;
+    }
+    uint8_t child = node & 0x07;
+    for (uint8_t i = 0; i < num_radios; ++i) {
+        if (children[i] & (1 << child)) {
+            return networks[i];
+        }
+    }
+    return networks[0];
+}
+
+// ensure the compiler is aware of the possible datatype for the template class
+template class ESBNetworkGateway<RF24>;
+    #if defined(ARDUINO_ARCH_NRF52) || defined(ARDUINO_ARCH_NRF52840) || defined(ARDUINO_ARCH_NRF52833) || defined(ARDUINO_NRF54L15)
+template class ESBNetworkGateway<nrf_to_nrf>;
+    #endif
+
+#endif // defined(ENABLE_GATEWAY)
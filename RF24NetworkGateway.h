@@ -0,0 +1,166 @@
+/*
+ Copyright (C) 2011 James Coliz, Jr. <maniacbug@ymail.com>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ version 2 as published by the Free Software Foundation.
+ */
+
+#ifndef __RF24NETWORKGATEWAY_H__
+#define __RF24NETWORKGATEWAY_H__
+
+/**
+ * @file RF24NetworkGateway.h
+ *
+ * Class declaration for RF24NetworkGateway, a master node that serves its subtrees with several radios
+ */
+
+#include "RF24Network.h"
+
+#if defined(ENABLE_GATEWAY) || defined(DOXYGEN_FORCED)
+
+/** The most radios a gateway can use: one for each level 1 child */
+    #define GATEWAY_MAX_RADIOS (NUM_PIPES - 1)
+
+/**
+ * A master node that uses several radios, each serving its own level 1 children
+ *
+ * A single radio can only send or receive on one channel at a time, which limits the throughput of
+ * the master node that most traffic goes through. A gateway instead attaches one network instance
+ * per radio, each on its own channel, and assigns the level 1 children (and their subtrees) to them.
+ * The children of a radio use the radio's channel. Each instance has the master address (00), so
+ * the address space stays the same as with one radio.
+ *
+ * The gateway presents the instances as a single network: writes are sent through the radio that
+ * serves the destination's subtree, and messages received by any radio are read from one queue.
+ * Frames between nodes of different subtrees are handed from one radio to the other, so the
+ * subtrees can reach each other as usual.
+ *
+ * @code
+ * RF24 radio1(22, 0), radio2(23, 10);
+ * RF24Network network1(radio1), network2(radio2);
+ * RF24NetworkGateway gateway;
+ *
+ * radio1.begin();
+ * radio1.setChannel(90);
+ * radio2.begin();
+ * radio2.setChannel(110);
+ * gateway.attach(network1, 0b000110); // nodes 01 and 02 (on channel 90)
+ * gateway.attach(network2, 0b111000); // nodes 03, 04 and 05 (on channel 110)
+ * gateway.begin();
+ * @endcode
+ *
+ * @note Message IDs are taken from the process-wide RF24NetworkHeader::next_id, so they stay
+ * unique across the radios that share the master address.
+ * @note This needs to be enabled via `#define ENABLE_GATEWAY` in RF24Network_config.h
+ *
+ * @tparam radio_t The `radio` object's type. Defaults to `RF24` for legacy behavior.
+ */
+template<class radio_t = RF24>
+class ESBNetworkGateway
+{
+public:
+    /** Construct a gateway without radios */
+    ESBNetworkGateway(void);
+
+    /**
+     * Add a radio to the gateway
+     *
+     * @param network The network instance of the radio. The radio's channel must be set before
+     * begin() is called, and must differ from the other radios' channels.
+     * @param children A bitmask of the level 1 children that this radio serves. Bit N is set for
+     * node 0N, ie: `0b000110` for nodes 01 and 02. Children that aren't assigned to any radio are
+     * served by the first radio.
+     * @return False if @ref GATEWAY_MAX_RADIOS radios are already attached, otherwise true
+     */
+    bool attach(ESBNetwork<radio_t>& network, uint8_t children);
+
+    /**
+     * Start all radios' networks as the master node (00)
+     *
+     * Call this after all radios are attached (and configured).
+     */
+    void begin(void);
+
+    /**
+     * Update all radios' networks
+     *
+     * This must be called regularly (instead of ESBNetwork::update()).
+     *
+     * @return The last non-zero value returned by ESBNetwork::update(), or 0
+     */
+    uint8_t update(void);
+
+    /** @return True if any radio has a message waiting to be read */
+    bool available(void);
+
+    /**
+     * Read the next available header, without removing the message from the queue
+     *
+     * @param[out] header The header of the message that read() returns next
+     * @return The length of the message, or 0 if no message is available
+     */
+    uint16_t peek(RF24NetworkHeader& header);
+
+    /**
+     * Read the next available message
+     *
+     * The radios' queues are read in turn, so a busy subtree doesn't hold up the others.
+     *
+     * @param[out] header The header of the message
+     * @param[out] message Pointer to memory where the message should be placed
+     * @param maxlen The largest message size which can be held in @p message
+     * @return The total number of bytes copied into @p message, or 0 if no message is available
+     */
+    uint16_t read(RF24NetworkHeader& header, void* message, uint16_t maxlen);
+
+    /**
+     * Send a message through the radio that serves the destination's subtree
+     *
+     * @see ESBNetwork::write()
+     */
+    bool write(RF24NetworkHeader& header, const void* message, uint16_t len);
+
+    #if defined(RF24NetworkMulticast) || defined(DOXYGEN_FORCED)
+    /**
+     * Send a multicast message through all radios
+     *
+     * @see ESBNetwork::multicast()
+     * @return True if the message was sent through all radios
+     */
+    bool multicast(RF24NetworkHeader& header, const void* message, uint16_t len, uint8_t level = 7);
+    #endif
+
+    /**
+     * The network instance that serves a node
+     *
+     * @param node The logical address of the node
+     * @return The instance of the radio that serves the node's subtree. NULL if no radio is attached.
+     */
+    ESBNetwork<radio_t>* networkFor(uint16_t node);
+
+    /** @return The number of attached radios */
+    uint8_t radios(void) const { return num_radios; }
+
+private:
+    ESBNetwork<radio_t>* networks[GATEWAY_MAX_RADIOS];
+    uint8_t children[GATEWAY_MAX_RADIOS]; /* The bitmask of level 1 children that each radio serves */
+    uint8_t num_radios;
+    uint8_t next_read; /* The radio whose queue is read first */
+
+    /* Find the next radio (starting at next_read) with a message waiting. Returns num_radios if none */
+    uint8_t next_available(void);
+};
+
+/**
+ * A type definition of the template class `ESBNetworkGateway` to maintain naming consistency with
+ * `RF24Network`.
+ */
+typedef ESBNetworkGateway<RF24> RF24NetworkGateway;
+    #if defined(ARDUINO_ARCH_NRF52) || defined(ARDUINO_ARCH_NRF52840) || defined(ARDUINO_ARCH_NRF52833) || defined(ARDUINO_NRF54L15)
+typedef ESBNetworkGateway<nrf_to_nrf> RF52NetworkGateway;
+    #endif
+
+#endif // defined(ENABLE_GATEWAY) || defined(DOXYGEN_FORCED)
+
+#endif // __RF24NETWORKGATEWAY_H__
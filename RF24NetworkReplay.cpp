@@ -0,0 +1,170 @@
+/*
+ Copyright (C) 2011 James Coliz, Jr. <maniacbug@ymail.com>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ version 2 as published by the Free Software Foundation.
+ */
+#include "RF24Network_config.h"
+
+#if defined(RF24_LINUX)
+    #include <string.h>
+    #if !defined(USE_RF24_LIB_SRC)
+        #include <RF24/RF24.h>
+    #endif
+#endif
+#include "RF24NetworkReplay.h"
+#if defined(USE_RF24_LIB_SRC)
+    #include <RF24.h>
+#endif
+
+#if defined(ENABLE_REPLAY) && defined(RF24_LINUX)
+/******************************************************************/
+
+RF24NetworkReplay::RF24NetworkReplay(void) : speed(1), acknowledge(true), next_frame(0), start_time(0), sent(0)
+{
+    memset(tx_address, 0, sizeof(tx_address));
+}
+
+/******************************************************************/
+
+static uint32_t replay_swap(uint32_t value, bool swapped)
+{
+    return swapped ? __builtin_bswap32(value) : value;
+}
+
+/******************************************************************/
+
+bool RF24NetworkReplay::load(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    // A file written on a host with the other byte order has a swapped magic number
+    uint32_t pcapHeader[6];
+    bool swapped = false;
+    bool ok = fread(pcapHeader, sizeof(pcapHeader), 1, file) == 1;
+    if (ok) {
+        swapped = pcapHeader[0] == 0xd4c3b2a1;
+        ok = (swapped || pcapHeader[0] == 0xa1b2c3d4) && replay_swap(pcapHeader[5], swapped) == RF24NETWORK_PCAP_LINKTYPE;
+    }
+
+    frames.clear();
+    uint64_t first = 0;
+    uint32_t record[4];
+    uint8_t packet[RF24NETWORK_PCAP_HEADER_SIZE + RF24NETWORK_MAX_FRAME_SIZE];
+    while (ok && fread(record, sizeof(record), 1, file) == 1) {
+        uint32_t len = replay_swap(record[2], swapped);
+        if (len > sizeof(packet) || fread(packet, len, 1, file) != 1) {
+            ok = false;
+            break;
+        }
+        // The frames sent by the captured node are its response, which the replay reproduces
+        if (len <= RF24NETWORK_PCAP_HEADER_SIZE || packet[0] & RF24NETWORK_CAPTURE_TX) {
+            continue;
+        }
+        replayFrame frame;
+        frame.time = (uint64_t)replay_swap(record[0], swapped) * 1000000 + replay_swap(record[1], swapped);
+        if (frames.empty()) {
+            first = frame.time;
+        }
+        frame.time -= first;
+        frame.pipe = packet[1];
+        frame.size = len - RF24NETWORK_PCAP_HEADER_SIZE;
+        memcpy(frame.data, packet + RF24NETWORK_PCAP_HEADER_SIZE, frame.size);
+        frames.push_back(frame);
+    }
+    fclose(file);
+    rewind();
+    return ok;
+}
+
+/******************************************************************/
+
+bool RF24NetworkReplay::record(const char* path)
+{
+    return recorder.open(path);
+}
+
+/******************************************************************/
+
+void RF24NetworkReplay::rewind(void)
+{
+    next_frame = 0;
+    sent = 0;
+    start_time = now();
+}
+
+/******************************************************************/
+
+uint64_t RF24NetworkReplay::now(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/******************************************************************/
+
+bool RF24NetworkReplay::available(uint8_t* pipe)
+{
+    if (finished()) {
+        return false;
+    }
+    const replayFrame& frame = frames[next_frame];
+    if (speed > 0 && (now() - start_time) * speed < frame.time) {
+        return false;
+    }
+    if (pipe) {
+        *pipe = frame.pipe;
+    }
+    return true;
+}
+
+/******************************************************************/
+
+uint8_t RF24NetworkReplay::getDynamicPayloadSize(void)
+{
+    return finished() ? 0 : frames[next_frame].size;
+}
+
+/******************************************************************/
+
+void RF24NetworkReplay::read(void* buf, uint8_t len)
+{
+    if (finished()) {
+        return;
+    }
+    memcpy(buf, frames[next_frame].data, rf24_min(len, frames[next_frame].size));
+    ++next_frame;
+}
+
+/******************************************************************/
+
+bool RF24NetworkReplay::writeFast(const void* buf, uint8_t len, const bool multicast)
+{
+    ++sent;
+
+    // Decode the next hop from the address (see ESBNetworkBase::pipe_address())
+    static const uint8_t address_translation[] = {0xc3, 0x3c, 0x33, 0xce, 0x3e, 0xe3, 0xec, 0xee};
+    const uint8_t* digit = (const uint8_t*)memchr(address_translation, tx_address[0], sizeof(address_translation));
+    RF24NetworkCapture capture;
+    capture.pipe = digit ? digit - address_translation : 0;
+    capture.node = 0;
+    for (uint8_t i = 1, shift = 0; i < sizeof(tx_address) && tx_address[i] != 0xCC; ++i, shift += 3) {
+        digit = (const uint8_t*)memchr(address_translation, tx_address[i], sizeof(address_translation));
+        capture.node |= (digit ? digit - address_translation : 0) << shift;
+    }
+
+    capture.time = micros();
+    capture.duration = 0;
+    capture.frame = (const uint8_t*)buf;
+    capture.size = len;
+    capture.flags = RF24NETWORK_CAPTURE_TX | (acknowledge || multicast ? RF24NETWORK_CAPTURE_OK : 0);
+    RF24NetworkPcap::capture(capture, &recorder);
+    return acknowledge;
+}
+
+#endif // defined(ENABLE_REPLAY) && defined(RF24_LINUX)
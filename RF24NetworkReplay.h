@@ -0,0 +1,146 @@
+/*
+ Copyright (C) 2011 James Coliz, Jr. <maniacbug@ymail.com>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ version 2 as published by the Free Software Foundation.
+ */
+
+#ifndef __RF24NETWORKREPLAY_H__
+#define __RF24NETWORKREPLAY_H__
+
+/**
+ * @file RF24NetworkReplay.h
+ *
+ * Class declaration for RF24NetworkReplay, a radio that replays captured frames (Linux only)
+ */
+
+#include "RF24Network.h"
+
+#if (defined(ENABLE_REPLAY) && defined(RF24_LINUX)) || defined(DOXYGEN_FORCED)
+    #include <vector>
+
+/**
+ * A radio that replays the frames of a capture file, instead of using real hardware (Linux only)
+ *
+ * The frames that a node received in a pcap file written by RF24NetworkPcap are fed to
+ * ESBNetwork::update() with their original timing (or faster), and the frames that the network
+ * layer sends in response can be recorded to another pcap file. So a trace captured in the field
+ * can be used as a reproducible test or benchmark input.
+ *
+ * @code
+ * RF24NetworkReplay replay;
+ * ESBNetwork<RF24NetworkReplay> network(replay);
+ *
+ * replay.load("field.pcap");
+ * replay.record("response.pcap");
+ * replay.speed = 0; // as fast as possible
+ * network.begin(01);
+ * while (!replay.finished()) {
+ *     network.update();
+ *     while (network.available()) {
+ *         RF24NetworkHeader header;
+ *         network.read(header, 0, 0);
+ *     }
+ * }
+ * @endcode
+ *
+ * @note Use the capture of the node that is replayed (with the same address), since its frames
+ * are addressed to it. Only the received frames are replayed, the sent frames are skipped.
+ * @note This needs to be enabled via `#define ENABLE_REPLAY` in RF24Network_config.h
+ */
+class RF24NetworkReplay
+{
+public:
+    /** Construct a replay without frames */
+    RF24NetworkReplay(void);
+
+    /**
+     * Load the received frames of a capture file, and start replaying them
+     *
+     * @param path A pcap file written by RF24NetworkPcap
+     * @return False if the file can't be read or isn't an RF24Network capture
+     */
+    bool load(const char* path);
+
+    /**
+     * Record the frames that the network layer sends to a pcap file
+     *
+     * The pseudo-header's next hop and pipe are decoded from the radio address that the frame was
+     * sent to, and its duration is 0.
+     *
+     * @param path The pcap file to create (replacing an existing file)
+     * @return False if the file can't be created
+     */
+    bool record(const char* path);
+
+    /** Start replaying the loaded frames from the beginning */
+    void rewind(void);
+
+    /** @return True once all loaded frames were read by the network layer */
+    bool finished(void) const { return next_frame >= frames.size(); }
+
+    /** @return The number of loaded frames */
+    uint32_t frameCount(void) const { return frames.size(); }
+
+    /** @return The number of frames that the network layer sent since the last load() or rewind() */
+    uint32_t sentCount(void) const { return sent; }
+
+    /**
+     * The replay speed. 1 replays the frames with their original timing, 2 twice as fast, and so
+     * on. 0 makes every frame available as soon as the previous one was read. Defaults to 1.
+     */
+    float speed;
+
+    /** Whether the sent frames are reported as acknowledged by the next hop. Defaults to true. */
+    bool acknowledge;
+
+    /**
+     * @name Radio interface
+     *
+     * The methods of the `radio_t` interface that ESBNetwork uses
+     */
+    /**@{*/
+    bool isValid(void) { return true; }
+    void setChannel(uint8_t) {}
+    void setAutoAck(bool) {}
+    void setAutoAck(uint8_t, bool) {}
+    void setRetries(uint8_t, uint8_t) {}
+    void enableDynamicAck(void) {}
+    void enableDynamicPayloads(void) {}
+    void openReadingPipe(uint8_t, const uint8_t*) {}
+    void startListening(void) {}
+    void stopListening(void) {}
+    void stopListening(const uint8_t* address) { memcpy(tx_address, address, sizeof(tx_address)); }
+    bool available(void) { return available(NULL); }
+    bool available(uint8_t* pipe);
+    uint8_t getDynamicPayloadSize(void);
+    void read(void* buf, uint8_t len);
+    bool writeFast(const void* buf, uint8_t len, const bool multicast);
+    bool txStandBy(void) { return acknowledge; }
+    bool txStandBy(uint32_t, bool = 0) { return acknowledge; }
+    /**@}*/
+
+private:
+    /* A received frame of the capture */
+    struct replayFrame
+    {
+        uint64_t time; /* Microseconds since the first frame */
+        uint8_t pipe;
+        uint8_t size;
+        uint8_t data[RF24NETWORK_MAX_FRAME_SIZE];
+    };
+    std::vector<replayFrame> frames;
+    size_t next_frame;     /* The next frame to be read */
+    uint64_t start_time;   /* The system time (in microseconds) when the replay started */
+    uint8_t tx_address[5]; /* The address that frames are sent to */
+    uint32_t sent;
+    RF24NetworkPcap recorder;
+
+    /* The system time in microseconds */
+    static uint64_t now(void);
+};
+
+#endif // (defined(ENABLE_REPLAY) && defined(RF24_LINUX)) || defined(DOXYGEN_FORCED)
+
+#endif // __RF24NETWORKREPLAY_H__
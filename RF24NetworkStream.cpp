@@ -0,0 +1,391 @@
+/*
+ Copyright (C) 2011 James Coliz, Jr. <maniacbug@ymail.com>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ version 2 as published by the Free Software Foundation.
+ */
+#include "RF24Network_config.h"
+
+#if defined(RF24_LINUX)
+    #include <string.h>
+    #if !defined(USE_RF24_LIB_SRC)
+        #include <RF24/RF24.h>
+    #endif
+#else
+    #include "RF24.h"
+    #if defined(ARDUINO_ARCH_NRF52) || defined(ARDUINO_ARCH_NRF52840) || defined(ARDUINO_NRF54L15)
+        #include <nrf_to_nrf.h>
+    #endif
+#endif
+#include "RF24Network.h"
+#include "RF24NetworkStream.h"
+#if defined(USE_RF24_LIB_SRC)
+    #include <RF24.h>
+#endif
+
+/* Flags of a NETWORK_STREAM_DATA message */
+#define STREAM_FLAG_FIN 1 // The last segment of the transfer
+
+/******************************************************************/
+
+template<class radio_t>
+ESBNetworkStream<radio_t>::ESBNetworkStream(ESBNetwork<radio_t>& _network) : window(STREAM_MAX_WINDOW), network(_network)
+{
+    memset(tx_segments, 0, sizeof(tx_segments));
+    tx_data = NULL;
+    tx_length = 0;
+    tx_to = 0;
+    tx_base = 0;
+    tx_next = 0;
+    tx_total = 0;
+    tx_transfer = 0;
+    tx_state = STREAM_IDLE;
+    tx_window = STREAM_MAX_WINDOW;
+    tx_retransmissions = 0;
+    srtt = 0;
+    rttvar = 0;
+    rto = STREAM_MAX_RTO;
+
+    rx_buffer = NULL;
+    rx_maxlen = 0;
+    rx_length = 0;
+    rx_sack = 0;
+    rx_ack_time = 0;
+    rx_from = 0xFFFF; // not a valid logical address
+    rx_next = 0;
+    rx_fin = 0;
+    rx_segment = 0;
+    rx_transfer = 0;
+    rx_state = STREAM_IDLE;
+    rx_unacked = 0;
+}
+
+/******************************************************************/
+
+template<class radio_t>
+bool ESBNetworkStream<radio_t>::send(uint16_t to_node, const void* data, uint32_t len)
+{
+    uint32_t segments = (len + STREAM_SEGMENT_SIZE - 1) / STREAM_SEGMENT_SIZE;
+    if (tx_state == STREAM_ACTIVE || segments > 0xFFFF) {
+        return false;
+    }
+
+    tx_data = reinterpret_cast<const uint8_t*>(data);
+    tx_length = len;
+    tx_to = to_node;
+    tx_base = 0;
+    tx_next = 0;
+    tx_total = segments ? segments : 1; // An empty transfer still sends its (empty) last segment
+    tx_transfer++;
+    tx_state = STREAM_ACTIVE;
+    tx_window = STREAM_MAX_WINDOW;
+    tx_retransmissions = 0;
+    srtt = 0;
+    rttvar = 0;
+    // No round-trip-time was measured yet, so start with a conservative timeout
+    rto = rf24_max(rf24_min(network.routeTimeout * 3, STREAM_MAX_RTO), STREAM_MIN_RTO);
+
+    IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET Stream %d to 0%o: %lu bytes in %u segments\n\r"), tx_transfer, to_node, (unsigned long)len, tx_total););
+    return true;
+}
+
+/******************************************************************/
+
+template<class radio_t>
+void ESBNetworkStream<radio_t>::listen(void* buffer, uint32_t maxlen)
+{
+    rx_buffer = reinterpret_cast<uint8_t*>(buffer);
+    rx_maxlen = maxlen;
+    rx_length = 0;
+    rx_state = STREAM_IDLE;
+    // The last transfer's sender & id are kept, so its late retransmissions are still acknowledged
+    // instead of being mistaken for a new transfer.
+}
+
+/******************************************************************/
+
+template<class radio_t>
+uint8_t ESBNetworkStream<radio_t>::update(void)
+{
+    uint8_t result = network.update();
+
+    // Process the stream messages at the front of the queue
+    while (network.available()) {
+        RF24NetworkHeader header;
+        uint16_t size = network.peek(header);
+        if (header.type != NETWORK_STREAM_DATA && header.type != NETWORK_STREAM_ACK) {
+            break;
+        }
+        uint8_t message[STREAM_DATA_HEADER_SIZE + STREAM_SEGMENT_SIZE];
+        network.read(header, message, sizeof(message));
+        if (size > sizeof(message)) {
+            continue; // segment size mismatch; not for us
+        }
+        if (header.type == NETWORK_STREAM_DATA) {
+            handle_data(header, message, size);
+        }
+        else {
+            handle_ack(header, message, size);
+        }
+    }
+
+    uint32_t now = millis();
+
+    // Acknowledge segments that are waiting for another one to be acknowledged with
+    if (rx_unacked && now - rx_ack_time >= STREAM_ACK_DELAY) {
+        send_ack();
+    }
+
+    if (tx_state != STREAM_ACTIVE) {
+        return result;
+    }
+
+    // Retransmit segments that weren't acknowledged in time
+    bool timedOut = false;
+    for (uint16_t seq = tx_base; seq != tx_next; ++seq) {
+        txSegment& segment = tx_segments[seq % STREAM_MAX_WINDOW];
+        if (segment.acked || now - segment.sent_time < rto) {
+            continue;
+        }
+        if (segment.retries >= STREAM_MAX_RETRIES) {
+            IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET Stream %d to 0%o failed at segment %u\n\r"), tx_transfer, tx_to, seq););
+            tx_state = STREAM_FAILED;
+            return result;
+        }
+        segment.retries++;
+        tx_retransmissions++;
+        timedOut = true;
+        send_segment(seq);
+    }
+    if (timedOut) {
+        // Exponential backoff until the next round-trip-time measurement
+        rto = rf24_min(rto * 2, STREAM_MAX_RTO);
+    }
+
+    // Fill the window with new segments
+    uint8_t limit = rf24_min(rf24_min(window, tx_window), STREAM_MAX_WINDOW);
+    if (!limit) {
+        limit = 1; // Always keep a segment in flight, so a closed window is probed
+    }
+    while (tx_next != tx_total && tx_next - tx_base < limit) {
+        txSegment& segment = tx_segments[tx_next % STREAM_MAX_WINDOW];
+        segment.retries = 0;
+        segment.acked = false;
+        send_segment(tx_next);
+        tx_next++;
+    }
+    return result;
+}
+
+/******************************************************************/
+
+template<class radio_t>
+void ESBNetworkStream<radio_t>::send_segment(uint16_t seq)
+{
+    uint8_t message[STREAM_DATA_HEADER_SIZE + STREAM_SEGMENT_SIZE];
+    uint32_t pos = (uint32_t)seq * STREAM_SEGMENT_SIZE;
+    uint16_t len = rf24_min(tx_length - pos, STREAM_SEGMENT_SIZE);
+
+    message[0] = tx_transfer;
+    message[1] = seq + 1 == tx_total ? STREAM_FLAG_FIN : 0;
+    message[2] = seq & 0xFF;
+    message[3] = seq >> 8;
+    memcpy(message + STREAM_DATA_HEADER_SIZE, tx_data + pos, len);
+
+    RF24NetworkHeader header(tx_to, NETWORK_STREAM_DATA);
+    network.write(header, message, STREAM_DATA_HEADER_SIZE + len);
+    // A failed write is handled like a lost segment, and retransmitted after the timeout
+    tx_segments[seq % STREAM_MAX_WINDOW].sent_time = millis();
+}
+
+/******************************************************************/
+
+template<class radio_t>
+void ESBNetworkStream<radio_t>::ack_segment(uint16_t seq, uint32_t now)
+{
+    txSegment& segment = tx_segments[seq % STREAM_MAX_WINDOW];
+    if (segment.acked) {
+        return;
+    }
+    segment.acked = true;
+
+    // Only segments that were sent once give an unambiguous round-trip-time (Karn's algorithm)
+    if (!segment.retries) {
+        uint16_t sample = rf24_max(rf24_min(now - segment.sent_time, STREAM_MAX_RTO), 1);
+        if (!srtt) {
+            srtt = sample;
+            rttvar = sample / 2;
+        }
+        else {
+            uint16_t delta = srtt > sample ? srtt - sample : sample - srtt;
+            rttvar = rttvar - (rttvar >> 2) + (delta >> 2); // 3/4 rttvar + 1/4 delta
+            srtt = srtt - (srtt >> 3) + (sample >> 3);      // 7/8 srtt + 1/8 sample
+        }
+        uint32_t timeout = (uint32_t)srtt + 4 * (uint32_t)rttvar;
+        rto = rf24_max(rf24_min(timeout, STREAM_MAX_RTO), STREAM_MIN_RTO);
+    }
+}
+
+/******************************************************************/
+
+template<class radio_t>
+void ESBNetworkStream<radio_t>::handle_ack(RF24NetworkHeader& header, const uint8_t* message, uint16_t len)
+{
+    if (tx_state != STREAM_ACTIVE || len < STREAM_ACK_SIZE || header.from_node != tx_to || message[0] != tx_transfer) {
+        return;
+    }
+
+    uint16_t next = message[2] | (message[3] << 8);
+    uint32_t sack = message[4] | ((uint32_t)message[5] << 8) | ((uint32_t)message[6] << 16) | ((uint32_t)message[7] << 24);
+    if (next > tx_next) {
+        return; // Acknowledges segments that weren't sent yet
+    }
+    if (next < tx_base) {
+        // A stale ACK, overtaken by a newer one. Its SACK bits would hit the window slots of later segments
+        return;
+    }
+    tx_window = message[1];
+
+    uint32_t now = millis();
+    for (uint16_t seq = tx_base; seq < next; ++seq) {
+        ack_segment(seq, now);
+    }
+    for (uint8_t i = 0; i < 32 && (uint16_t)(next + 1 + i) < tx_next; ++i) {
+        if (sack & ((uint32_t)1 << i)) {
+            ack_segment(next + 1 + i, now);
+        }
+    }
+
+    while (tx_base != tx_next && tx_segments[tx_base % STREAM_MAX_WINDOW].acked) {
+        tx_base++;
+    }
+    if (tx_base == tx_total) {
+        IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET Stream %d to 0%o complete, %u retransmissions\n\r"), tx_transfer, tx_to, tx_retransmissions););
+        tx_state = STREAM_COMPLETE;
+        return;
+    }
+
+    // Later segments arrived, so the oldest one was most likely lost. Resend it right away (once)
+    // instead of waiting for the timeout.
+    txSegment& oldest = tx_segments[tx_base % STREAM_MAX_WINDOW];
+    if (sack && next == tx_base && !oldest.retries && now - oldest.sent_time >= srtt) {
+        oldest.retries++;
+        tx_retransmissions++;
+        send_segment(tx_base);
+    }
+}
+
+/******************************************************************/
+
+template<class radio_t>
+void ESBNetworkStream<radio_t>::handle_data(RF24NetworkHeader& header, const uint8_t* message, uint16_t len)
+{
+    if (len < STREAM_DATA_HEADER_SIZE) {
+        return;
+    }
+    uint8_t transfer = message[0];
+    bool fin = message[1] & STREAM_FLAG_FIN;
+    uint16_t seq = message[2] | (message[3] << 8);
+    len -= STREAM_DATA_HEADER_SIZE;
+
+    if (header.from_node != rx_from || transfer != rx_transfer) {
+        // Start a new transfer, unless the buffer holds a completed one or another node's transfer is
+        // in progress. A new transfer from the same node replaces one that its sender abandoned.
+        if (!rx_buffer || rx_state == STREAM_COMPLETE || (rx_state == STREAM_ACTIVE && header.from_node != rx_from)) {
+            return;
+        }
+        rx_from = header.from_node;
+        rx_transfer = transfer;
+        rx_next = 0;
+        rx_sack = 0;
+        rx_fin = 0;
+        rx_segment = 0;
+        rx_length = 0;
+        rx_unacked = 0;
+        rx_state = STREAM_ACTIVE;
+    }
+    else if (rx_state != STREAM_ACTIVE) {
+        // The sender missed the ACK that completed its transfer
+        send_ack();
+        return;
+    }
+
+    if (seq > rx_next + 32) {
+        return; // Beyond what a NETWORK_STREAM_ACK can describe
+    }
+    if (seq < rx_next || (seq > rx_next && (rx_sack & ((uint32_t)1 << (seq - rx_next - 1))))) {
+        send_ack(); // A duplicate, so the ACK for it was lost
+        return;
+    }
+    if (!fin) {
+        if (!rx_segment) {
+            rx_segment = len;
+        }
+        else if (len != rx_segment) {
+            return;
+        }
+    }
+    else if (seq && !rx_segment) {
+        return; // Its position is unknown until a full segment arrives. It will be retransmitted.
+    }
+
+    uint32_t pos = (uint32_t)seq * rx_segment;
+    if (pos < rx_maxlen) {
+        memcpy(rx_buffer + pos, message + STREAM_DATA_HEADER_SIZE, rf24_min(len, rx_maxlen - pos));
+    }
+    if (fin) {
+        rx_fin = seq + 1;
+        rx_length = rf24_min(pos + len, rx_maxlen);
+    }
+
+    if (seq == rx_next) {
+        rx_next++;
+        while (rx_sack & 1) {
+            rx_sack >>= 1;
+            rx_next++;
+        }
+        rx_sack >>= 1;
+    }
+    else {
+        rx_sack |= (uint32_t)1 << (seq - rx_next - 1);
+    }
+
+    if (!rx_unacked++) {
+        rx_ack_time = millis();
+    }
+    if (rx_fin && rx_next == rx_fin) {
+        IF_RF24NETWORK_DEBUG(printf_P(PSTR("NET Stream %d from 0%o complete: %lu bytes\n\r"), rx_transfer, rx_from, (unsigned long)rx_length););
+        rx_state = STREAM_COMPLETE;
+    }
+    // ACK every other segment, and right away when there's a gap or the transfer is complete
+    if (rx_unacked >= 2 || rx_sack || rx_state == STREAM_COMPLETE) {
+        send_ack();
+    }
+}
+
+/******************************************************************/
+
+template<class radio_t>
+void ESBNetworkStream<radio_t>::send_ack(void)
+{
+    uint8_t message[STREAM_ACK_SIZE];
+    message[0] = rx_transfer;
+    message[1] = rf24_min(window, STREAM_MAX_WINDOW);
+    message[2] = rx_next & 0xFF;
+    message[3] = rx_next >> 8;
+    message[4] = rx_sack & 0xFF;
+    message[5] = (rx_sack >> 8) & 0xFF;
+    message[6] = (rx_sack >> 16) & 0xFF;
+    message[7] = rx_sack >> 24;
+
+    RF24NetworkHeader header(rx_from, NETWORK_STREAM_ACK);
+    network.write(header, message, STREAM_ACK_SIZE);
+    rx_unacked = 0;
+}
+
+// ensure the compiler is aware of the possible datatype for the template class
+template class ESBNetworkStream<RF24>;
+#if defined(ARDUINO_ARCH_NRF52) || defined(ARDUINO_ARCH_NRF52840) || defined(ARDUINO_ARCH_NRF52833) || defined(ARDUINO_NRF54L15)
+template class ESBNetworkStream<nrf_to_nrf>;
+#endif
@@ -0,0 +1,247 @@
+/*
+ Copyright (C) 2011 James Coliz, Jr. <maniacbug@ymail.com>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ version 2 as published by the Free Software Foundation.
+ */
+
+#ifndef __RF24NETWORKSTREAM_H__
+#define __RF24NETWORKSTREAM_H__
+
+/**
+ * @file RF24NetworkStream.h
+ *
+ * Class declaration for RF24NetworkStream, a reliable bulk transfer layer on top of RF24Network
+ */
+
+#include "RF24Network.h"
+
+#if defined(RF24_LINUX) || !defined(F_CPU) || F_CPU >= 50000000
+    #ifndef STREAM_SEGMENT_SIZE
+        /**
+         * @brief The number of transfer bytes carried by each @ref NETWORK_STREAM_DATA message.
+         *
+         * Segments larger than a single radio frame are fragmented (and re-assembled) by the
+         * network layer as usual. Both nodes of a transfer must use the same value.
+         */
+        #define STREAM_SEGMENT_SIZE 92 // 4 radio frames
+    #endif
+    #ifndef STREAM_MAX_WINDOW
+        /** @brief The maximum number of segments that can be in flight (unacknowledged) at once */
+        #define STREAM_MAX_WINDOW 16
+    #endif
+#else
+    #ifndef STREAM_SEGMENT_SIZE
+        #define STREAM_SEGMENT_SIZE 20 // Fits a segment in a single 32 byte radio frame
+    #endif
+    #ifndef STREAM_MAX_WINDOW
+        #define STREAM_MAX_WINDOW 4
+    #endif
+#endif
+
+#if STREAM_MAX_WINDOW > 32
+    #error "STREAM_MAX_WINDOW can't exceed the 32 segments tracked by a NETWORK_STREAM_ACK"
+#endif
+
+/** @brief A segment is abandoned (and the transfer fails) after this many retransmissions */
+#ifndef STREAM_MAX_RETRIES
+    #define STREAM_MAX_RETRIES 10
+#endif
+
+/** @brief Bounds (in milliseconds) of the retransmission timeout derived from the measured round-trip-time */
+#ifndef STREAM_MIN_RTO
+    #define STREAM_MIN_RTO 20
+#endif
+#ifndef STREAM_MAX_RTO
+    #define STREAM_MAX_RTO 2000
+#endif
+
+/** @brief The longest time (in milliseconds) that the receiver delays a @ref NETWORK_STREAM_ACK to acknowledge several segments at once */
+#ifndef STREAM_ACK_DELAY
+    #define STREAM_ACK_DELAY 10
+#endif
+
+/** The size of the header that precedes the data of each @ref NETWORK_STREAM_DATA message */
+#define STREAM_DATA_HEADER_SIZE 4
+/** The size of a @ref NETWORK_STREAM_ACK message */
+#define STREAM_ACK_SIZE 8
+
+/**
+ * @defgroup STREAM_STATES Stream transfer states
+ *
+ * Values returned by ESBNetworkStream::sendState() and ESBNetworkStream::receiveState()
+ * @{
+ */
+/** No transfer has been started */
+#define STREAM_IDLE 0
+/** A transfer is in progress */
+#define STREAM_ACTIVE 1
+/** The transfer was completed (all data was acknowledged by, or delivered to, this node) */
+#define STREAM_COMPLETE 2
+/** The transfer was abandoned after a segment reached @ref STREAM_MAX_RETRIES */
+#define STREAM_FAILED 3
+/** @} */
+
+/**
+ * Reliable transfer of arbitrary length data between two nodes
+ *
+ * Each transfer is split into numbered segments of @ref STREAM_SEGMENT_SIZE bytes that are sent
+ * as @ref NETWORK_STREAM_DATA messages, so the usual routing and fragmentation of
+ * ESBNetwork::write() applies. Up to `window` segments are in flight at once. The receiver answers
+ * with @ref NETWORK_STREAM_ACK messages carrying a cumulative ACK and a selective ACK bitmap, and
+ * segments that aren't acknowledged within the retransmission timeout (derived from the measured
+ * round-trip-time) are sent again.
+ *
+ * @code
+ * RF24Network network(radio);
+ * RF24NetworkStream stream(network);
+ *
+ * // sender
+ * stream.send(00, firmware, sizeof(firmware));
+ * while (stream.sendState() == STREAM_ACTIVE) {
+ *     stream.update();
+ * }
+ *
+ * // receiver
+ * stream.listen(buffer, sizeof(buffer));
+ * while (stream.receiveState() != STREAM_COMPLETE) {
+ *     stream.update();
+ * }
+ * @endcode
+ *
+ * @note update() reads @ref NETWORK_STREAM_DATA and @ref NETWORK_STREAM_ACK messages from the
+ * front of the network's queue. Other messages must be read by the application as usual, or they
+ * will hold up the transfer.
+ * They are queued even when RF24Network::returnSysMsgs is set (as by RF24Mesh), like fragments.
+ *
+ * @tparam radio_t The `radio` object's type. Defaults to `RF24` for legacy behavior.
+ */
+template<class radio_t = RF24>
+class ESBNetworkStream
+{
+public:
+    /**
+     * Construct the stream layer
+     *
+     * @param _network The network instance that transfers are sent and received through
+     */
+    ESBNetworkStream(ESBNetwork<radio_t>& _network);
+
+    /**
+     * Keep the transfers going
+     *
+     * This must be called regularly (instead of ESBNetwork::update()). It updates the network,
+     * processes received stream messages, retransmits timed out segments and sends new ones.
+     *
+     * @return The value returned by ESBNetwork::update()
+     */
+    uint8_t update(void);
+
+    /**
+     * Start sending data to another node
+     *
+     * @param to_node The logical address of the receiving node
+     * @param data The data to send. This memory is read while the transfer is active, so it must
+     * remain valid (and unchanged) until sendState() is no longer @ref STREAM_ACTIVE.
+     * @param len The number of bytes to send
+     * @return False if a transfer is already active, otherwise true
+     */
+    bool send(uint16_t to_node, const void* data, uint32_t len);
+
+    /** @return The state of the current (or last) outgoing transfer. See @ref STREAM_STATES */
+    uint8_t sendState(void) const { return tx_state; }
+
+    /**
+     * Prepare to receive a transfer
+     *
+     * The next transfer from any node is written to @p buffer. Transfers that are larger than
+     * @p maxlen are truncated.
+     *
+     * @param buffer The memory where received data is placed
+     * @param maxlen The size of @p buffer
+     */
+    void listen(void* buffer, uint32_t maxlen);
+
+    /** @return The state of the current (or last) incoming transfer. See @ref STREAM_STATES */
+    uint8_t receiveState(void) const { return rx_state; }
+
+    /** @return The number of bytes of the completed incoming transfer */
+    uint32_t receivedLength(void) const { return rx_length; }
+
+    /** @return The logical address of the node that sent the current (or last) incoming transfer */
+    uint16_t receivedFrom(void) const { return rx_from; }
+
+    /** @return The smoothed round-trip-time (in milliseconds) measured for the outgoing transfer */
+    uint16_t rtt(void) const { return srtt; }
+
+    /** @return The number of segments that were retransmitted during the outgoing transfer */
+    uint16_t retransmissions(void) const { return tx_retransmissions; }
+
+    /**
+     * The number of segments that may be in flight at once (up to @ref STREAM_MAX_WINDOW).
+     * The receiver can further reduce this in each @ref NETWORK_STREAM_ACK.
+     */
+    uint8_t window;
+
+private:
+    ESBNetwork<radio_t>& network; /** The underlying network layer */
+
+    /* Sender state */
+    struct txSegment
+    {
+        uint32_t sent_time; /* millis() of the last transmission */
+        uint8_t retries;    /* The number of retransmissions */
+        bool acked;
+    };
+    txSegment tx_segments[STREAM_MAX_WINDOW]; /* Indexed by seq % STREAM_MAX_WINDOW */
+    const uint8_t* tx_data;
+    uint32_t tx_length;
+    uint16_t tx_to;
+    uint16_t tx_base;    /* The oldest unacknowledged segment */
+    uint16_t tx_next;    /* The next segment that has not been sent yet */
+    uint16_t tx_total;   /* The number of segments in the transfer */
+    uint8_t tx_transfer; /* Identifies the transfer in each message */
+    uint8_t tx_state;    /* See STREAM_STATES */
+    uint8_t tx_window;   /* The window advertised by the receiver */
+    uint16_t tx_retransmissions;
+    uint16_t srtt;   /* Smoothed round-trip-time (ms) */
+    uint16_t rttvar; /* Round-trip-time variation (ms) */
+    uint16_t rto;    /* Retransmission timeout (ms) */
+
+    /* Receiver state */
+    uint8_t* rx_buffer;
+    uint32_t rx_maxlen;
+    uint32_t rx_length;
+    uint32_t rx_sack;     /* Bit N is set if segment `rx_next + N + 1` was received */
+    uint32_t rx_ack_time; /* millis() of the oldest segment that hasn't been acknowledged yet */
+    uint16_t rx_from;
+    uint16_t rx_next;    /* The next in-order segment expected (the cumulative ACK) */
+    uint16_t rx_fin;     /* The number of segments, once the last segment was received (0 until then) */
+    uint16_t rx_segment; /* The transfer's segment size, learned from full segments */
+    uint8_t rx_transfer;
+    uint8_t rx_state;   /* See STREAM_STATES */
+    uint8_t rx_unacked; /* The number of segments received since the last ACK was sent */
+
+    /* Send a segment of the outgoing transfer */
+    void send_segment(uint16_t seq);
+    /* Process a NETWORK_STREAM_DATA message */
+    void handle_data(RF24NetworkHeader& header, const uint8_t* message, uint16_t len);
+    /* Process a NETWORK_STREAM_ACK message */
+    void handle_ack(RF24NetworkHeader& header, const uint8_t* message, uint16_t len);
+    /* Mark a segment of the outgoing transfer as delivered */
+    void ack_segment(uint16_t seq, uint32_t now);
+    /* Send a NETWORK_STREAM_ACK to the node sending the incoming transfer */
+    void send_ack(void);
+};
+
+/**
+ * A type definition of the template class `ESBNetworkStream` to maintain naming consistency with
+ * `RF24Network`.
+ */
+typedef ESBNetworkStream<RF24> RF24NetworkStream;
+#if defined(ARDUINO_ARCH_NRF52) || defined(ARDUINO_ARCH_NRF52840) || defined(ARDUINO_ARCH_NRF52833) || defined(ARDUINO_NRF54L15)
+typedef ESBNetworkStream<nrf_to_nrf> RF52NetworkStream;
+#endif
+
+#endif // __RF24NETWORKSTREAM_H__
@@ -83,6 +83,73 @@
     /* Enable tracking of success and failures for all transmissions, routed and user initiated */
     //#define ENABLE_NETWORK_STATS
 
+    /* Queue staggered transmissions (multicast relays, NETWORK_POLL replies, routed ACK-type deliveries) instead of blocking update() with delays.
+     * Routed frames to the same node keep their order, and multicast relays are staggered in 1ms steps instead of 600us */
+    //#define ENABLE_DEFERRED_TX
+
+    /* Drop (and count) multicast frames that were already received recently, instead of enqueuing and relaying them again */
+    //#define ENABLE_MULTICAST_DEDUP
+
+    /* Drop (and count) unicast messages whose header id was already received from the same source (ie: retransmissions after a lost network ACK) */
+    //#define ENABLE_UNICAST_DEDUP
+
+    /* Pause senders with NETWORK_FLOW_CONTROL messages when the incoming frame buffer is nearly full, and stop writing to nodes that paused this node */
+    //#define ENABLE_FLOW_CONTROL
+
+    /* Deliver received messages to handlers registered per header type with setHandler(), straight from update() */
+    //#define ENABLE_TYPE_HANDLERS
+
+    /* Re-assemble fragmented messages in place at the end of the incoming frame buffer (MCUs only), instead of in a separate MAX_PAYLOAD_SIZE buffer */
+    //#define ENABLE_SHARED_RX_BUFFER
+
+    /* Allow fragmented messages to be compressed (see FLAG_COMPRESSION) and decompress received ones */
+    //#define ENABLE_COMPRESSION
+
+    /* Send continuation fragments with a 3 byte header to neighbors that support it, so they carry 5 more bytes of payload */
+    //#define ENABLE_COMPACT_FRAGMENTS
+
+    /* Unpack received NETWORK_AGGREGATE frames, and allow small messages to be aggregated (see aggregateDelay) */
+    //#define ENABLE_AGGREGATION
+
+    /* Learn which nodes are in radio range, and send messages to them directly when that is shorter than the tree route */
+    //#define ENABLE_NEIGHBOR_ROUTES
+
+    /* Hold NETWORK_ACKs back briefly, so they can ride on a message to the same node (see NETWORK_PIGGYBACK_ACK) */
+    //#define ENABLE_ACK_PIGGYBACK
+
+    /* Follow the TDMA slot schedule of the parent's beacons, and send beacons to children (see tdmaSlotTime) */
+    //#define ENABLE_TDMA
+
+    /* Let a master node serve its level 1 children with several radios (see ESBNetworkGateway) */
+    //#define ENABLE_GATEWAY
+
+    /* Pass every received and sent radio frame to a capture function (see setCapture() and RF24NetworkPcap) */
+    //#define ENABLE_CAPTURE
+
+    /* Compile RF24NetworkReplay, a radio that replays captured frames for tests and benchmarks (Linux only) */
+    //#define ENABLE_REPLAY
+
+    /* Queue received messages per source (child subtree), and read them by deficit round robin (see maxSourceQueue) */
+    //#define ENABLE_FAIR_QUEUING
+
+    /* Keep only the latest unread message of the types chosen with setCoalescing() from each node */
+    //#define ENABLE_COALESCING
+
+    /* Send messages larger than MAX_PAYLOAD_SIZE with 16-bit fragment counts, and re-assemble them in growing buffers (receiving on Linux only) */
+    //#define ENABLE_JUMBO_MESSAGES
+
+    /* Probe the smallest frame size on the path to each destination, and fragment messages to it accordingly (see ESBNetwork::pathMtu()) */
+    //#define ENABLE_PATH_MTU
+
+    /* Allow messages to be written from several buffers, or by a function that produces each frame's bytes (see ESBNetwork::writev()) */
+    //#define ENABLE_GATHER_WRITES
+
+    /* Pass the fragments of large messages to a handler as they arrive, instead of re-assembling them (see ESBNetwork::setFragmentHandler()) */
+    //#define ENABLE_FRAGMENT_STREAMING
+
+    /* Also compile ESBNetworkBase with this alternate configuration policy, for instances with their own payload size, fragmentation or user payload setting. See RF24NetworkPolicy */
+    //#define RF24NETWORK_EXTRA_CONFIG RF24NetworkPolicy<32, false>
+
     #ifndef DISABLE_DYNAMIC_PAYLOADS
         /** Enable dynamic payloads - If using different types of nRF24L01 modules, some may be incompatible when using this feature **/
         #define ENABLE_DYNAMIC_PAYLOADS
@@ -109,6 +176,221 @@
 #endif
 /*************************************/
 
+/** @brief (Linux) The default for ESBNetwork::maxQueuedFrames */
+#ifndef NETWORK_QUEUE_FRAMES
+    #define NETWORK_QUEUE_FRAMES 1024
+#endif
+/** @brief (Linux) The default for ESBNetwork::maxExternalFrames */
+#ifndef NETWORK_EXTERNAL_QUEUE_FRAMES
+    #define NETWORK_EXTERNAL_QUEUE_FRAMES 1024
+#endif
+
+#if defined(ENABLE_DEFERRED_TX)
+    /** @brief The number of frames that can be waiting in the deferred transmission scheduler at once */
+    #ifndef DEFERRED_TX_SLOTS
+        #define DEFERRED_TX_SLOTS 4
+    #endif
+    /** @brief The number of 1 millisecond buckets in the deferred transmission timer wheel */
+    #ifndef DEFERRED_TX_WHEEL_SIZE
+        #define DEFERRED_TX_WHEEL_SIZE 16
+    #endif
+#endif // defined(ENABLE_DEFERRED_TX)
+
+#if defined(ENABLE_MULTICAST_DEDUP)
+    /** @brief The number of recently received multicast frames remembered for duplicate detection */
+    #ifndef MULTICAST_DEDUP_SIZE
+        #define MULTICAST_DEDUP_SIZE 8
+    #endif
+    /** @brief How long (in milliseconds) a received multicast frame is remembered for duplicate detection */
+    #ifndef MULTICAST_DEDUP_TIMEOUT
+        #define MULTICAST_DEDUP_TIMEOUT 500
+    #endif
+#endif // defined(ENABLE_MULTICAST_DEDUP)
+
+#if defined(ENABLE_UNICAST_DEDUP)
+    /** @brief The number of source nodes tracked by the unicast duplicate filter (12 bytes each) */
+    #ifndef UNICAST_DEDUP_SOURCES
+        #if defined linux || defined __linux || !defined F_CPU || F_CPU >= 50000000
+            #define UNICAST_DEDUP_SOURCES 32
+        #else
+            #define UNICAST_DEDUP_SOURCES 4
+        #endif
+    #endif
+    /** @brief A source's history of message IDs is forgotten after it is silent for this many milliseconds (allows for restarted nodes) */
+    #ifndef UNICAST_DEDUP_TIMEOUT
+        #define UNICAST_DEDUP_TIMEOUT 3000
+    #endif
+#endif // defined(ENABLE_UNICAST_DEDUP)
+
+#if defined(ENABLE_FLOW_CONTROL)
+    /** @brief The number of nodes that can be paused by (and pausing) this node at once */
+    #ifndef FLOW_CONTROL_NODES
+        #define FLOW_CONTROL_NODES 4
+    #endif
+    /** @brief How long (in milliseconds) a sender is paused for, unless it is resumed sooner */
+    #ifndef FLOW_CONTROL_PAUSE
+        #define FLOW_CONTROL_PAUSE 100
+    #endif
+    /** @brief (Linux) Senders are paused once this many frames are waiting to be read, and resumed at half as many */
+    #ifndef FLOW_CONTROL_QUEUE_FRAMES
+        #define FLOW_CONTROL_QUEUE_FRAMES 64
+    #endif
+    /** @brief Senders are paused when less than this many bytes of the frame buffer are free (room for a full 32 byte radio frame) */
+    #ifndef FLOW_CONTROL_MIN_SPACE
+        #define FLOW_CONTROL_MIN_SPACE 36
+    #endif
+    /** @brief Paused senders are resumed once this many bytes of the frame buffer are free */
+    #ifndef FLOW_CONTROL_RESUME_SPACE
+        #define FLOW_CONTROL_RESUME_SPACE (MAIN_BUFFER_SIZE / 2)
+    #endif
+#endif // defined(ENABLE_FLOW_CONTROL)
+
+#if defined(ENABLE_TYPE_HANDLERS)
+    /**
+     * @brief Handlers can be registered for the header types below this number.
+     *
+     * Each entry uses 2 pointers of RAM, so smaller devices only cover the user types by default.
+     */
+    #ifndef NETWORK_HANDLER_TYPES
+        #if defined linux || defined __linux || !defined F_CPU || F_CPU >= 50000000
+            #define NETWORK_HANDLER_TYPES 256
+        #else
+            #define NETWORK_HANDLER_TYPES 128
+        #endif
+    #endif
+#endif // defined(ENABLE_TYPE_HANDLERS)
+
+#if defined(ENABLE_COMPRESSION)
+    /**
+     * @brief The largest message size that can be used with compression.
+     *
+     * Compressed messages are marked by the top bit of the first fragment's 8-bit fragment count
+     * (see NETWORK_COMPRESSED_FRAGMENTS), so every message must take less than 128 fragments of 24 bytes.
+     */
+    #define NETWORK_COMPRESSION_MAX_SIZE (127 * 24)
+    #if MAX_PAYLOAD_SIZE > NETWORK_COMPRESSION_MAX_SIZE
+        #error "ENABLE_COMPRESSION requires a MAX_PAYLOAD_SIZE of 3048 bytes or less (fewer than 128 fragments)"
+    #endif
+#endif // defined(ENABLE_COMPRESSION)
+
+#if defined(ENABLE_COMPACT_FRAGMENTS)
+    /**
+     * @brief The number of fragmented messages that can cross this node's links at once with compact headers.
+     *
+     * Each entry uses 7 bytes of RAM, and there is a table for sent and for received messages.
+     */
+    #ifndef NETWORK_COMPACT_CONTEXTS
+        #if defined linux || defined __linux || !defined F_CPU || F_CPU >= 50000000
+            #define NETWORK_COMPACT_CONTEXTS 16
+        #else
+            #define NETWORK_COMPACT_CONTEXTS 4
+        #endif
+    #endif
+#endif // defined(ENABLE_COMPACT_FRAGMENTS)
+
+#if defined(ENABLE_NEIGHBOR_ROUTES)
+    /** @brief The number of probed nodes (in radio range or not) that are remembered */
+    #ifndef NETWORK_NEIGHBORS
+        #if defined linux || defined __linux || !defined F_CPU || F_CPU >= 50000000
+            #define NETWORK_NEIGHBORS 16
+        #else
+            #define NETWORK_NEIGHBORS 4
+        #endif
+    #endif
+    /** @brief The time (in milliseconds) before a node that couldn't be reached is probed again */
+    #ifndef NETWORK_NEIGHBOR_PROBE_INTERVAL
+        #define NETWORK_NEIGHBOR_PROBE_INTERVAL 10000
+    #endif
+#endif // defined(ENABLE_NEIGHBOR_ROUTES)
+
+#if defined(ENABLE_ACK_PIGGYBACK)
+    /**
+     * @brief The longest time (in milliseconds) that a @ref NETWORK_ACK waits for a message to the same node.
+     *
+     * It is then sent by itself. This delays the ACK, so it should stay well below the sender's
+     * `routeTimeout`.
+     */
+    #ifndef NETWORK_ACK_HOLD
+        #define NETWORK_ACK_HOLD 10
+    #endif
+    /** @brief The number of NETWORK_ACKs that can be held back at once. More are sent right away */
+    #ifndef NETWORK_HELD_ACKS
+        #if defined linux || defined __linux || !defined F_CPU || F_CPU >= 50000000
+            #define NETWORK_HELD_ACKS 8
+        #else
+            #define NETWORK_HELD_ACKS 2
+        #endif
+    #endif
+#endif // defined(ENABLE_ACK_PIGGYBACK)
+
+#if defined(ENABLE_TDMA)
+    #if !defined(RF24NetworkMulticast)
+        #error "ENABLE_TDMA requires RF24NetworkMulticast to send and receive beacons"
+    #endif
+    /** @brief The maximum number of slots (after the beacon's) in a TDMA frame */
+    #ifndef NETWORK_TDMA_SLOTS
+        #define NETWORK_TDMA_SLOTS 8
+    #endif
+    /** @brief A child keeps its slot for this long (in milliseconds) after the parent last heard from it */
+    #ifndef NETWORK_TDMA_IDLE
+        #define NETWORK_TDMA_IDLE 5000
+    #endif
+    /** @brief A child stops following the schedule after missing this many beacons in a row */
+    #ifndef NETWORK_TDMA_MISSED_BEACONS
+        #define NETWORK_TDMA_MISSED_BEACONS 3
+    #endif
+#endif // defined(ENABLE_TDMA)
+
+#if defined(ENABLE_FAIR_QUEUING)
+    /** @brief The bytes that each source may be served per turn of the deficit round robin (see ESBNetwork::maxSourceQueue) */
+    #ifndef NETWORK_FAIR_QUANTUM
+        #define NETWORK_FAIR_QUANTUM 32
+    #endif
+#endif // defined(ENABLE_FAIR_QUEUING)
+
+#if defined(ENABLE_JUMBO_MESSAGES)
+    #if defined(DISABLE_FRAGMENTATION)
+        #error "ENABLE_JUMBO_MESSAGES requires fragmentation"
+    #endif
+    /** @brief The default of ESBNetwork::maxJumboSize, the largest jumbo message that Linux nodes re-assemble */
+    #ifndef NETWORK_JUMBO_MAX_SIZE
+        #define NETWORK_JUMBO_MAX_SIZE 65535
+    #endif
+    #if NETWORK_JUMBO_MAX_SIZE > 65535
+        #error "NETWORK_JUMBO_MAX_SIZE can't exceed the 65535 bytes of a 16-bit message size"
+    #endif
+#endif // defined(ENABLE_JUMBO_MESSAGES)
+
+#if defined(ENABLE_PATH_MTU)
+    /** @brief The number of destinations whose path payload size is remembered */
+    #ifndef NETWORK_PATH_MTU_NODES
+        #if defined linux || defined __linux || !defined F_CPU || F_CPU >= 50000000
+            #define NETWORK_PATH_MTU_NODES 8
+        #else
+            #define NETWORK_PATH_MTU_NODES 4
+        #endif
+    #endif
+    /** @brief The payload size (in bytes) used for destinations that weren't probed yet: that of an nRF24 frame */
+    #ifndef NETWORK_PATH_MTU_DEFAULT
+        #define NETWORK_PATH_MTU_DEFAULT 24
+    #endif
+    /** @brief The time (in milliseconds) after which a destination's path is probed again */
+    #ifndef NETWORK_PATH_MTU_TIMEOUT
+        #define NETWORK_PATH_MTU_TIMEOUT 60000
+    #endif
+#endif // defined(ENABLE_PATH_MTU)
+
+#if defined(ENABLE_FRAGMENT_STREAMING) && defined(DISABLE_FRAGMENTATION)
+    #error "ENABLE_FRAGMENT_STREAMING requires fragmentation"
+#endif
+
+#if defined(ENABLE_FRAGMENT_STREAMING)
+    /** @brief A streamed message is aborted when none of its fragments arrived for this many milliseconds */
+    #ifndef FRAGMENT_STREAM_TIMEOUT
+        #define FRAGMENT_STREAM_TIMEOUT 1000
+    #endif
+#endif // defined(ENABLE_FRAGMENT_STREAMING)
+
 #endif // RF24_NETWORK_CONFIG_H
 
 #ifdef __cplusplus
@@ -87,6 +87,8 @@ std::string toString_wrap(RF24NetworkHeader& ref)
 void (RF24Network::*begin1)(uint8_t, uint16_t) = &RF24Network::begin;
 void (RF24Network::*begin2)(uint16_t) = &RF24Network::begin;
 uint16_t (RF24Network::*peek_header)(RF24NetworkHeader&) = &RF24Network::peek;
+uint8_t (RF24Network::*update1)(void) = &RF24Network::update;
+uint8_t (RF24Network::*update2)(uint8_t, uint32_t) = &RF24Network::update;
 
 // **************** RF24Network exposed  *****************
 
@@ -101,7 +103,8 @@ BOOST_PYTHON_MODULE(RF24Network)
         .def("peek", peek_header, (bp::arg("header")))
         .def("peek", &peek_read_wrap, (bp::arg("maxlen") = MAX_PAYLOAD_SIZE))
         .def("read", &read_wrap, (bp::arg("maxlen") = MAX_PAYLOAD_SIZE))
-        .def("update", &RF24Network::update)
+        .def("update", update1)
+        .def("update", update2, (bp::arg("maxFrames"), bp::arg("maxMicros") = 0))
         .def("write", &write_wrap, (bp::arg("header"), bp::arg("buf")))
 
 #if defined RF24NetworkMulticast
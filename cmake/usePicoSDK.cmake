@@ -11,6 +11,8 @@ add_library(RF24Network INTERFACE)
 
 target_sources(RF24Network INTERFACE
     ${CMAKE_CURRENT_LIST_DIR}/../RF24Network.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../RF24NetworkStream.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../RF24NetworkGateway.cpp
 )
 
 target_include_directories(RF24Network INTERFACE
@@ -0,0 +1,190 @@
+-- Wireshark dissector for RF24Network captures (see RF24NetworkPcap in RF24Network.h)
+--
+-- Copy this file to Wireshark's personal plugins folder (Help > About Wireshark > Folders),
+-- or run `wireshark -X lua_script:rf24network.lua network.pcap`.
+-- The pcap files use LINKTYPE_USER0 (147). Each packet starts with an 8 byte pseudo-header
+-- (flags, pipe, next hop/own node, TX duration in microseconds), followed by the radio frame.
+
+local rf24 = Proto("rf24network", "RF24Network")
+rf24.prefs.compression = Pref.bool("Nodes use ENABLE_COMPRESSION", false,
+    "The top bit of a first fragment's count marks a compressed message (instead of counting 128 fragments)")
+
+local system_types = {
+    [128] = "NETWORK_ADDR_RESPONSE",
+    [130] = "NETWORK_PING",
+    [131] = "EXTERNAL_DATA_TYPE",
+    [148] = "NETWORK_FIRST_FRAGMENT",
+    [149] = "NETWORK_MORE_FRAGMENTS",
+    [150] = "NETWORK_LAST_FRAGMENT",
+    [153] = "NETWORK_JUMBO_FIRST_FRAGMENT",
+    [154] = "NETWORK_JUMBO_MORE_FRAGMENTS",
+    [155] = "NETWORK_JUMBO_LAST_FRAGMENT",
+    [193] = "NETWORK_ACK",
+    [194] = "NETWORK_POLL",
+    [195] = "NETWORK_REQ_ADDRESS",
+    [200] = "NETWORK_MORE_FRAGMENTS_NACK",
+    [201] = "NETWORK_STREAM_DATA",
+    [202] = "NETWORK_STREAM_ACK",
+    [203] = "NETWORK_FLOW_CONTROL",
+    [204] = "NETWORK_COMPACT_HELLO",
+    [205] = "NETWORK_AGGREGATE",
+    [206] = "NETWORK_NEIGHBOR_PROBE",
+    [207] = "NETWORK_TDMA_BEACON",
+    [208] = "NETWORK_MTU_PROBE",
+    [209] = "NETWORK_MTU_REPLY",
+}
+
+local FIRST_FRAGMENT, MORE_FRAGMENTS, LAST_FRAGMENT = 148, 149, 150
+local JUMBO_FIRST_FRAGMENT, JUMBO_LAST_FRAGMENT = 153, 155
+local AGGREGATE = 205
+
+local function octal(value)
+    return string.format("0%o", value)
+end
+
+local function type_name(value)
+    if value <= 127 then
+        return string.format("user %d", value)
+    end
+    return system_types[value] or tostring(value)
+end
+
+-- Capture pseudo-header
+local f_flags = ProtoField.uint8("rf24network.capture.flags", "Capture flags", base.HEX)
+local f_tx = ProtoField.bool("rf24network.capture.tx", "Sent", 8, nil, 0x01)
+local f_ok = ProtoField.bool("rf24network.capture.ok", "Acknowledged", 8, nil, 0x02)
+local f_multicast = ProtoField.bool("rf24network.capture.multicast", "Multicast", 8, nil, 0x04)
+local f_pipe = ProtoField.uint8("rf24network.capture.pipe", "Pipe")
+local f_node = ProtoField.uint16("rf24network.capture.node", "Next hop / node", base.OCT)
+local f_duration = ProtoField.uint32("rf24network.capture.duration", "TX duration (us)")
+
+-- RF24NetworkHeader
+local f_from = ProtoField.uint16("rf24network.from", "From node", base.OCT)
+local f_to = ProtoField.uint16("rf24network.to", "To node", base.OCT)
+local f_id = ProtoField.uint16("rf24network.id", "Message ID")
+local f_type = ProtoField.uint8("rf24network.type", "Type")
+local f_reserved = ProtoField.uint8("rf24network.reserved", "Reserved", base.HEX)
+local f_frag_count = ProtoField.uint8("rf24network.fragments", "Fragment count")
+local f_compressed = ProtoField.bool("rf24network.compressed", "Compressed", 8, nil, 0x80)
+local f_frag_id = ProtoField.uint8("rf24network.fragment_id", "Fragments left")
+local f_msg_type = ProtoField.uint8("rf24network.message_type", "Message type")
+local f_piggyback = ProtoField.bool("rf24network.piggyback_ack", "Carries NETWORK_ACK", 8, nil, 0x80)
+local f_jumbo_count = ProtoField.uint16("rf24network.jumbo.fragments", "Fragments left")
+
+-- Compact continuation fragment header (ENABLE_COMPACT_FRAGMENTS)
+local f_compact_id = ProtoField.uint8("rf24network.compact.id", "Message ID (low byte)")
+local f_compact_last = ProtoField.bool("rf24network.compact.last", "Last fragment", 8, nil, 0x08)
+local f_compact_pipe = ProtoField.uint8("rf24network.compact.pipe", "Sender's pipe", base.DEC, nil, 0x07)
+
+-- NETWORK_AGGREGATE sub-messages
+local f_sub_to = ProtoField.uint16("rf24network.aggregate.to", "To node", base.OCT)
+local f_sub_type = ProtoField.uint8("rf24network.aggregate.type", "Type")
+local f_sub_len = ProtoField.uint8("rf24network.aggregate.len", "Length")
+
+local f_payload = ProtoField.bytes("rf24network.payload", "Payload")
+
+rf24.fields = {
+    f_flags, f_tx, f_ok, f_multicast, f_pipe, f_node, f_duration,
+    f_from, f_to, f_id, f_type, f_reserved, f_frag_count, f_compressed, f_frag_id, f_msg_type, f_piggyback, f_jumbo_count,
+    f_compact_id, f_compact_last, f_compact_pipe,
+    f_sub_to, f_sub_type, f_sub_len, f_payload,
+}
+
+local function dissect_aggregate(buffer, tree)
+    local offset = 0
+    while offset + 4 <= buffer:len() do
+        local len = buffer(offset + 3, 1):uint()
+        local sub = tree:add(rf24, buffer(offset, math.min(4 + len, buffer:len() - offset)), "Message")
+        sub:add_le(f_sub_to, buffer(offset, 2))
+        sub:add(f_sub_type, buffer(offset + 2, 1)):append_text(" (" .. type_name(buffer(offset + 2, 1):uint()) .. ")")
+        sub:add(f_sub_len, buffer(offset + 3, 1))
+        if len > 0 and offset + 4 + len <= buffer:len() then
+            sub:add(f_payload, buffer(offset + 4, len))
+        end
+        offset = offset + 4 + len
+    end
+end
+
+function rf24.dissector(buffer, pinfo, tree)
+    if buffer:len() < 8 then
+        return 0
+    end
+    pinfo.cols.protocol = "RF24Network"
+    local root = tree:add(rf24, buffer(), "RF24Network")
+
+    local flags = buffer(0, 1):uint()
+    local capture = root:add(rf24, buffer(0, 8), "Capture")
+    local flag_tree = capture:add(f_flags, buffer(0, 1))
+    flag_tree:add(f_tx, buffer(0, 1))
+    flag_tree:add(f_ok, buffer(0, 1))
+    flag_tree:add(f_multicast, buffer(0, 1))
+    capture:add(f_pipe, buffer(1, 1))
+    capture:add_le(f_node, buffer(2, 2))
+    capture:add_le(f_duration, buffer(4, 4))
+
+    local frame = buffer(8):tvb()
+    local direction = bit32.band(flags, 0x01) ~= 0 and "TX" or "RX"
+    local result = bit32.band(flags, 0x02) ~= 0 and "" or " [failed]"
+
+    if frame:len() >= 3 and bit32.band(frame(1, 1):uint(), 0xF0) == 0xF0 then
+        -- A continuation fragment with a compact header
+        local header = root:add(rf24, frame(0, 3), "Compact header")
+        header:add(f_compact_id, frame(0, 1))
+        header:add(f_compact_last, frame(1, 1))
+        header:add(f_compact_pipe, frame(1, 1))
+        header:add(f_reserved, frame(2, 1))
+        if frame:len() > 3 then
+            root:add(f_payload, frame(3))
+        end
+        pinfo.cols.info = string.format("%s compact fragment id %d%s", direction, frame(0, 1):uint(), result)
+        return buffer:len()
+    end
+    if frame:len() < 8 then
+        return buffer:len()
+    end
+
+    local from_node = frame(0, 2):le_uint()
+    local to_node = frame(2, 2):le_uint()
+    local msg_type = frame(6, 1):uint()
+    local header = root:add(rf24, frame(0, 8), "RF24NetworkHeader")
+    header:add_le(f_from, frame(0, 2))
+    header:add_le(f_to, frame(2, 2))
+    header:add_le(f_id, frame(4, 2))
+    header:add(f_type, frame(6, 1)):append_text(" (" .. type_name(msg_type) .. ")")
+    if msg_type == FIRST_FRAGMENT and rf24.prefs.compression then
+        header:add(f_frag_count, frame(7, 1), bit32.band(frame(7, 1):uint(), 0x7F))
+        header:add(f_compressed, frame(7, 1))
+    elseif msg_type == FIRST_FRAGMENT then
+        header:add(f_frag_count, frame(7, 1))
+    elseif msg_type == MORE_FRAGMENTS then
+        header:add(f_frag_id, frame(7, 1))
+    elseif msg_type == LAST_FRAGMENT or msg_type == JUMBO_LAST_FRAGMENT then
+        header:add(f_msg_type, frame(7, 1)):append_text(" (" .. type_name(frame(7, 1):uint()) .. ")")
+    elseif msg_type <= 127 then
+        header:add(f_reserved, frame(7, 1))
+        header:add(f_piggyback, frame(7, 1))
+    else
+        header:add(f_reserved, frame(7, 1))
+    end
+
+    if frame:len() > 8 then
+        if msg_type >= JUMBO_FIRST_FRAGMENT and msg_type <= JUMBO_LAST_FRAGMENT and frame:len() >= 10 then
+            -- Jumbo fragments start with a 16 bit count of the fragments left
+            root:add_le(f_jumbo_count, frame(8, 2))
+            if frame:len() > 10 then
+                root:add(f_payload, frame(10))
+            end
+        elseif msg_type == AGGREGATE then
+            dissect_aggregate(frame(8):tvb(), root)
+        else
+            root:add(f_payload, frame(8))
+        end
+    end
+
+    pinfo.cols.src = octal(from_node)
+    pinfo.cols.dst = octal(to_node)
+    pinfo.cols.info = string.format("%s %s -> %s id %d %s%s", direction, octal(from_node), octal(to_node), frame(4, 2):le_uint(), type_name(msg_type), result)
+    return buffer:len()
+end
+
+DissectorTable.get("wtap_encap"):add(wtap.USER0, rf24)